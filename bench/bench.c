@@ -0,0 +1,429 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+/*
+ * Parser and node tracking microbenchmarks on synthetic frames
+ *
+ * The frame mix resembles a busy channel: beacons with realistic IE sets from
+ * a number of APs, QoS data between APs and stations, ACK, RTS and CTS and
+ * probe requests from random (MAC randomized) addresses.
+ *
+ * Allocations are counted by wrapping malloc, calloc and realloc at link time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "raw_parser.h"
+#include "netdev.h"
+#include "node.h"
+#include "essid.h"
+#include "beacon_cache.h"
+#include "log.h"
+
+#define NUM_FRAMES	8192
+#define NUM_APS		200
+#define NUM_STAS	2000
+#define FRAME_MAX	400
+#define FRAME_NS	1000000	/* synthetic clock: 1000 frames per second */
+
+struct frame {
+	unsigned char	buf[FRAME_MAX];
+	size_t		len;
+	bool		beacon;
+};
+
+static struct frame frames[NUM_FRAMES];
+static unsigned long allocs;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+	allocs++;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size)
+{
+	allocs++;
+	return __real_calloc(nmemb, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+	allocs++;
+	return __real_realloc(ptr, size);
+}
+
+void __attribute__ ((format (printf, 2, 3)))
+log_out(enum loglevel ll, const char* fmt, ...)
+{
+	(void)ll;
+	(void)fmt;
+}
+
+static uint32_t rnd_state = 0x12345678;
+
+static uint32_t rnd(void)
+{
+	/* xorshift32 */
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Frame generator
+ */
+
+static void mac_ap(unsigned char* mac, int i)
+{
+	mac[0] = 0x00; mac[1] = 0x11; mac[2] = 0x22;
+	mac[3] = 0xa0; mac[4] = i >> 8; mac[5] = i;
+}
+
+static void mac_sta(unsigned char* mac, int i)
+{
+	mac[0] = 0x00; mac[1] = 0x33; mac[2] = 0x44;
+	mac[3] = 0x50; mac[4] = i >> 8; mac[5] = i;
+}
+
+static void mac_random(unsigned char* mac)
+{
+	uint32_t r = rnd();
+	mac[0] = 0x02 | ((r & 0x3f) << 2); /* locally administered */
+	mac[1] = r >> 8; mac[2] = r >> 16; mac[3] = r >> 24;
+	r = rnd();
+	mac[4] = r; mac[5] = r >> 8;
+}
+
+/* radiotap with flags (FCS), rate, channel and signal */
+static size_t put_radiotap(unsigned char* b)
+{
+	static const unsigned char rt[] = {
+		0x00, 0x00, 0x10, 0x00, 0x2e, 0x00, 0x00, 0x00,
+		0x10, 0x0c, 0x85, 0x09, 0xc0, 0x00, 0x00, 0x00 };
+	memcpy(b, rt, sizeof(rt));
+	b[14] = -40 - (rnd() % 50);
+	return sizeof(rt);
+}
+
+static size_t put_hdr(unsigned char* b, uint16_t fc, const unsigned char* a1,
+		      const unsigned char* a2, const unsigned char* a3)
+{
+	b[0] = fc; b[1] = fc >> 8;
+	b[2] = 0; b[3] = 0;
+	memcpy(b + 4, a1, 6);
+	if (a2 == NULL)
+		return 10;
+	memcpy(b + 10, a2, 6);
+	if (a3 == NULL)
+		return 16;
+	memcpy(b + 16, a3, 6);
+	b[22] = rnd(); b[23] = rnd();
+	return 24;
+}
+
+static size_t put_ie(unsigned char* b, uint8_t id, const void* data, uint8_t len)
+{
+	b[0] = id;
+	b[1] = len;
+	memcpy(b + 2, data, len);
+	return len + 2;
+}
+
+static size_t gen_beacon(unsigned char* b, int ap)
+{
+	static const unsigned char rates[] = { 0x82, 0x84, 0x8b, 0x96, 0x0c, 0x12, 0x18, 0x24 };
+	unsigned char tim[] = { 0x00, 0x03, 0x00, 0x00 };
+	static const unsigned char country[] = { 'D', 'E', ' ', 0x01, 0x0d, 0x14 };
+	static const unsigned char ht_cap[26] = { 0xef, 0x19, 0x1b, 0xff, 0xff, 0xff };
+	static const unsigned char ht_oper[22] = { 0x06, 0x05 };
+	static const unsigned char rsn[] = { 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00,
+		0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x02, 0x0c, 0x00 };
+	static const unsigned char vht_cap[12] = { 0x91, 0x59, 0x82, 0x0f, 0xea, 0xff,
+		0x00, 0x00, 0xea, 0xff, 0x00, 0x00 };
+	static const unsigned char wmm[] = { 0x00, 0x50, 0xf2, 0x02, 0x01, 0x01, 0x80, 0x00,
+		0x03, 0xa4, 0x00, 0x00, 0x27, 0xa4, 0x00, 0x00, 0x42, 0x43, 0x5e, 0x00,
+		0x62, 0x32, 0x2f, 0x00 };
+	static const unsigned char bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+	unsigned char mac[6];
+	char ssid[32];
+	unsigned char chan = 1 + ap % 11;
+	size_t len;
+
+	tim[0] = rnd() % 3; /* DTIM count */
+	mac_ap(mac, ap);
+	len = put_radiotap(b);
+	len += put_hdr(b + len, WLAN_FRAME_BEACON, bcast, mac, mac);
+	memset(b + len, 0, 12); /* TSF, interval, capab */
+	b[len + 8] = 0x64;
+	b[len + 10] = 0x11; /* ESS, privacy */
+	len += 12;
+
+	snprintf(ssid, sizeof(ssid), "network-%d", ap / 3); /* some ESSIDs shared */
+	len += put_ie(b + len, WLAN_IE_ID_SSID, ssid, strlen(ssid));
+	len += put_ie(b + len, 1, rates, sizeof(rates));
+	len += put_ie(b + len, WLAN_IE_ID_DSSS_PARAM, &chan, 1);
+	len += put_ie(b + len, 5, tim, sizeof(tim));
+	len += put_ie(b + len, 7, country, sizeof(country));
+	len += put_ie(b + len, WLAN_IE_ID_HT_CAPAB, ht_cap, sizeof(ht_cap));
+	len += put_ie(b + len, WLAN_IE_ID_HT_OPER, ht_oper, sizeof(ht_oper));
+	len += put_ie(b + len, WLAN_IE_ID_RSN, rsn, sizeof(rsn));
+	len += put_ie(b + len, WLAN_IE_ID_VHT_CAPAB, vht_cap, sizeof(vht_cap));
+	len += put_ie(b + len, WLAN_IE_ID_VENDOR, wmm, sizeof(wmm));
+	return len + 4; /* FCS */
+}
+
+static size_t gen_probe_req(unsigned char* b)
+{
+	static const unsigned char rates[] = { 0x02, 0x04, 0x0b, 0x16, 0x0c, 0x12, 0x18, 0x24 };
+	static const unsigned char ht_cap[26] = { 0x2d, 0x01, 0x1b, 0xff, 0xff };
+	static const unsigned char bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+	unsigned char mac[6];
+	size_t len;
+
+	mac_random(mac);
+	len = put_radiotap(b);
+	len += put_hdr(b + len, WLAN_FRAME_PROBE_REQ, bcast, mac, bcast);
+	len += put_ie(b + len, WLAN_IE_ID_SSID, NULL, 0);
+	len += put_ie(b + len, 1, rates, sizeof(rates));
+	len += put_ie(b + len, WLAN_IE_ID_HT_CAPAB, ht_cap, sizeof(ht_cap));
+	return len + 4;
+}
+
+static size_t gen_qdata(unsigned char* b, int ap, int sta)
+{
+	unsigned char a[6], s[6];
+	size_t len, plen = 40 + rnd() % 200;
+
+	mac_ap(a, ap);
+	mac_sta(s, sta);
+	len = put_radiotap(b);
+	if (rnd() & 1)
+		len += put_hdr(b + len, WLAN_FRAME_QDATA | WLAN_FRAME_FC_FROM_DS | WLAN_FRAME_FC_PROTECTED, s, a, a);
+	else
+		len += put_hdr(b + len, WLAN_FRAME_QDATA | WLAN_FRAME_FC_TO_DS | WLAN_FRAME_FC_PROTECTED, a, s, a);
+	b[len] = rnd() & 7; /* TID */
+	b[len + 1] = 0;
+	len += 2;
+	memset(b + len, 0xaa, plen);
+	return len + plen + 4;
+}
+
+static size_t gen_ctrl(unsigned char* b, uint16_t type, int ap, int sta)
+{
+	unsigned char a[6], s[6];
+	size_t len;
+
+	mac_ap(a, ap);
+	mac_sta(s, sta);
+	len = put_radiotap(b);
+	if (type == WLAN_FRAME_RTS)
+		len += put_hdr(b + len, type, a, s, NULL);
+	else
+		len += put_hdr(b + len, type, s, NULL, NULL);
+	return len + 4;
+}
+
+static void gen_frames(void)
+{
+	int i, r, ap, sta;
+
+	for (i = 0; i < NUM_FRAMES; i++) {
+		r = rnd() % 100;
+		ap = rnd() % NUM_APS;
+		sta = rnd() % NUM_STAS;
+		frames[i].beacon = r < 10;
+		if (r < 10)
+			frames[i].len = gen_beacon(frames[i].buf, ap);
+		else if (r < 20)
+			frames[i].len = gen_probe_req(frames[i].buf);
+		else if (r < 55)
+			frames[i].len = gen_qdata(frames[i].buf, ap, sta);
+		else if (r < 85)
+			frames[i].len = gen_ctrl(frames[i].buf, WLAN_FRAME_ACK, ap, sta);
+		else if (r < 93)
+			frames[i].len = gen_ctrl(frames[i].buf, WLAN_FRAME_RTS, ap, sta);
+		else
+			frames[i].len = gen_ctrl(frames[i].buf, WLAN_FRAME_CTS, ap, sta);
+	}
+}
+
+/*
+ * Benchmarks
+ */
+
+static void report(const char* name, unsigned long num, uint64_t ns, unsigned long num_allocs)
+{
+	printf("%-22s %10lu frames %8.1f ns/frame %8.2f Mframes/s %8.3f allocs/frame\n",
+	       name, num, (double)ns / num, num * 1000.0 / ns, (double)num_allocs / num);
+}
+
+static void bench_parse(const char* name, int iter, enum uwifi_parse_level level)
+{
+	struct uwifi_packet p;
+	struct uwifi_ie_ref ies[UWIFI_IE_MAX];
+	unsigned long a = allocs;
+	uint64_t start = now_ns();
+	volatile int sink = 0;
+	int i, j;
+
+	for (j = 0; j < iter; j++) {
+		for (i = 0; i < NUM_FRAMES; i++) {
+			memset(&p, 0, sizeof(p));
+			if (level >= UWIFI_PARSE_FULL)
+				p.wlan_ie_idx = ies;
+			sink += uwifi_parse_raw_level(frames[i].buf, frames[i].len, &p,
+						      ARPHRD_IEEE80211_RADIOTAP, level);
+		}
+	}
+	report(name, (unsigned long)iter * NUM_FRAMES, now_ns() - start, allocs - a);
+}
+
+/* only the beacons, with or without beacon cache */
+static void bench_beacons(const char* name, int iter, bool cached)
+{
+	struct uwifi_beacon_cache bc;
+	struct uwifi_packet p;
+	struct uwifi_ie_ref ies[UWIFI_IE_MAX];
+	unsigned long a = allocs;
+	unsigned long num = 0;
+	uint64_t start;
+	volatile int sink = 0;
+	int i, j;
+
+	uwifi_beacon_cache_init(&bc);
+	start = now_ns();
+	for (j = 0; j < iter; j++) {
+		for (i = 0; i < NUM_FRAMES; i++) {
+			if (!frames[i].beacon)
+				continue;
+			memset(&p, 0, sizeof(p));
+			p.wlan_ie_idx = ies;
+			sink += uwifi_parse_raw_cached(frames[i].buf, frames[i].len, &p,
+						       ARPHRD_IEEE80211_RADIOTAP,
+						       UWIFI_PARSE_FULL, cached ? &bc : NULL);
+			num++;
+		}
+	}
+	report(name, num, now_ns() - start, allocs - a);
+	if (cached)
+		printf("%-22s %10lu hits %8lu misses\n", "  beacon cache",
+		       (unsigned long)bc.hits, (unsigned long)bc.misses);
+	uwifi_beacon_cache_free(&bc);
+}
+
+/* return time spent in uwifi_nodes_timeout() */
+static uint64_t run_nodes(struct uwifi_nodes* nodes, struct uwifi_essids* essids,
+			  int iter, unsigned int timeout, uint64_t* total)
+{
+	struct uwifi_packet p;
+	struct uwifi_node* n;
+	uint64_t last = 0;
+	uint64_t ts = 0;
+	uint64_t start = now_ns();
+	uint64_t t, t_timeout = 0;
+	int i, j;
+
+	for (j = 0; j < iter; j++) {
+		for (i = 0; i < NUM_FRAMES; i++) {
+			/* frame time instead of the clock, so expiry does
+			 * not depend on how fast the machine is */
+			ts += FRAME_NS;
+			memset(&p, 0, sizeof(p));
+			p.pkt_ts_ns = ts;
+			if (uwifi_parse_raw(frames[i].buf, frames[i].len, &p,
+					    ARPHRD_IEEE80211_RADIOTAP) < 0)
+				continue;
+			n = uwifi_node_update(&p, nodes);
+			if (n != NULL) {
+				uwifi_nodes_find_ap(n, nodes);
+				uwifi_essids_update(essids, &p, n);
+			}
+			if ((i & 1023) == 1023) {
+				t = now_ns();
+				uwifi_nodes_timeout(nodes, timeout, &last, ts);
+				t_timeout += now_ns() - t;
+			}
+		}
+	}
+	*total = now_ns() - start;
+	return t_timeout;
+}
+
+static void bench_nodes(const char* name, int iter, unsigned int timeout, bool pools)
+{
+	struct uwifi_nodes nodes;
+	struct uwifi_essids essids;
+	struct uwifi_pool node_pool, essid_pool;
+	unsigned long a;
+	uint64_t total, t_timeout;
+
+	uwifi_nodes_init(&nodes);
+	uwifi_essids_init(&essids);
+	if (pools) {
+		uwifi_pool_init(&node_pool, sizeof(struct uwifi_node), 1024, 0, false);
+		uwifi_pool_init(&essid_pool, sizeof(struct essid_info), 256, 0, false);
+		nodes.pool = &node_pool;
+		essids.pool = &essid_pool;
+	}
+
+	a = allocs;
+	t_timeout = run_nodes(&nodes, &essids, iter, timeout, &total);
+	report(name, (unsigned long)iter * NUM_FRAMES, total, allocs - a);
+	report("  of that timeout", (unsigned long)iter * NUM_FRAMES, t_timeout, 0);
+	printf("%-22s %10u nodes\n", "  nodes at end", nodes.idx.num);
+
+	uwifi_nodes_free(&nodes);
+	uwifi_essids_free(&essids);
+	if (pools) {
+		uwifi_pool_destroy(&node_pool);
+		uwifi_pool_destroy(&essid_pool);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int iter = argc > 1 ? atoi(argv[1]) : 100;
+
+	if (iter <= 0)
+		iter = 1;
+
+	gen_frames();
+	printf("%d synthetic frames, %d iterations\n\n", NUM_FRAMES, iter);
+
+	bench_parse("parse phy", iter, UWIFI_PARSE_PHY);
+	bench_parse("parse header", iter, UWIFI_PARSE_HDR);
+	bench_parse("parse full", iter, UWIFI_PARSE_FULL);
+	bench_beacons("parse beacons", iter, false);
+	bench_beacons("parse beacons cached", iter, true);
+	bench_nodes("nodes", iter, 60, false);
+	bench_nodes("nodes pool", iter, 60, true);
+	/* nodes not seen within the last 1000 frames expire: insert/evict
+	 * churn, the same in both runs */
+	bench_nodes("nodes churn", iter / 10 + 1, 1, false);
+	bench_nodes("nodes churn pool", iter / 10 + 1, 1, true);
+
+	return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+/*
+ * Replay a pcap or pcapng file through the whole receive pipeline and report
+ * throughput and per-stage latency percentiles.
+ *
+ * Stages are the PHY header (radiotap or prism), the 802.11 header and IEs,
+ * uwifi_fixup_packet_channel(), the node update including finding the AP and
+ * the ESSID update. Beacons go through a beacon cache like in the fanout
+ * workers. Every frame is timed with chained clock_gettime() calls
+ * so each stage includes about one timer call; the timer overhead is printed
+ * for reference. Throughput is measured in a separate untimed pass with
+ * uwifi_pcap_replay().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "raw_parser.h"
+#include "pcap_file.h"
+#include "netdev.h"
+#include "node.h"
+#include "essid.h"
+#include "ssid_table.h"
+#include "beacon_cache.h"
+#include "channel.h"
+#include "conf.h"
+#include "log.h"
+
+void __attribute__ ((format (printf, 2, 3)))
+log_out(enum loglevel ll, const char* fmt, ...)
+{
+	(void)ll;
+	(void)fmt;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Log-linear latency histogram: exact below 16ns, then 16 buckets per power
+ * of two, which limits the error to about 6%
+ */
+
+#define HIST_SUB	16
+#define HIST_BUCKETS	(29 * HIST_SUB)
+
+struct hist {
+	uint64_t	cnt[HIST_BUCKETS];
+	uint64_t	num;
+	uint64_t	sum;
+	uint64_t	max;
+};
+
+static unsigned int hist_idx(uint64_t v)
+{
+	int msb;
+
+	if (v < HIST_SUB)
+		return v;
+	if (v > UINT32_MAX)
+		v = UINT32_MAX;
+	msb = 63 - __builtin_clzll(v);
+	return (msb - 3) * HIST_SUB + ((v >> (msb - 4)) & (HIST_SUB - 1));
+}
+
+static uint64_t hist_val(unsigned int idx)
+{
+	if (idx < HIST_SUB)
+		return idx;
+	return (uint64_t)(HIST_SUB + idx % HIST_SUB) << (idx / HIST_SUB - 1);
+}
+
+static void hist_add(struct hist* h, uint64_t v)
+{
+	h->cnt[hist_idx(v)]++;
+	h->num++;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+}
+
+static uint64_t hist_percentile(const struct hist* h, double q)
+{
+	uint64_t target = q * h->num;
+	uint64_t acc = 0;
+	unsigned int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		acc += h->cnt[i];
+		if (acc > target)
+			return hist_val(i);
+	}
+	return h->max;
+}
+
+/*
+ * Pipeline
+ */
+
+enum stage {
+	STAGE_PHY,
+	STAGE_80211,
+	STAGE_FIXUP,
+	STAGE_NODE,
+	STAGE_ESSID,
+	STAGE_TOTAL,
+	STAGE_MAX
+};
+
+static const char* stage_names[STAGE_MAX] = {
+	"phy header", "802.11 + IEs", "channel fixup", "node update",
+	"essid update", "total"
+};
+
+struct replay {
+	struct uwifi_interface	intf;
+	struct uwifi_nodes	nodes;
+	struct uwifi_essids	essids;
+	struct uwifi_ssid_table	ssids;
+	struct uwifi_beacon_cache beacons;
+	struct hist		hist[STAGE_MAX];
+};
+
+/* channels are not known from a file, add them as they are seen */
+static void replay_add_channel(struct uwifi_interface* intf, unsigned int freq)
+{
+	if (freq == 0 || uwifi_channel_idx_from_freq(&intf->channels, freq) >= 0)
+		return;
+	uwifi_channel_list_add(&intf->channels, freq);
+}
+
+/* run one frame through the pipeline, timing each stage */
+static void replay_frame(struct replay* r, struct uwifi_pcap_frame* f)
+{
+	struct uwifi_packet p;
+	struct uwifi_ie_ref ies[UWIFI_IE_MAX];
+	struct uwifi_node* n;
+	uint64_t t[STAGE_MAX];
+	int ret = 0;
+
+	memset(&p, 0, sizeof(p));
+	p.pkt_ts_ns = f->ts_ns;	/* file time, like uwifi_pcap_replay() */
+	p.wlan_ie_idx = ies;
+
+	t[STAGE_PHY] = now_ns();
+	if (f->arphdr == ARPHRD_IEEE80211_RADIOTAP)
+		ret = uwifi_parse_radiotap(f->buf, f->len, &p);
+	else if (f->arphdr == ARPHRD_IEEE80211_PRISM)
+		ret = uwifi_parse_prism_header(f->buf, f->len, &p);
+	else if (f->arphdr != ARPHRD_IEEE80211)
+		return;
+	if (ret < 0 || (size_t)ret >= f->len)
+		return;
+
+	t[STAGE_80211] = now_ns();
+	/* 0 from the PHY parser is a bad FCS: allow packet but stop parsing */
+	if ((ret > 0 || f->arphdr == ARPHRD_IEEE80211) &&
+	    uwifi_parse_80211_header_cached(f->buf + ret, f->len - ret, &p,
+					    UWIFI_PARSE_FULL, &r->beacons) < 0)
+		return;
+
+	replay_add_channel(&r->intf, p.phy_freq);
+
+	t[STAGE_FIXUP] = now_ns();
+	uwifi_fixup_packet_channel(&p, &r->intf);
+
+	t[STAGE_NODE] = now_ns();
+	n = uwifi_node_update(&p, &r->nodes);
+	if (n != NULL)
+		uwifi_nodes_find_ap(n, &r->nodes);
+
+	t[STAGE_ESSID] = now_ns();
+	if (n != NULL)
+		uwifi_essids_update(&r->essids, &p, n);
+
+	t[STAGE_TOTAL] = now_ns();
+	for (int i = 0; i < STAGE_TOTAL; i++)
+		hist_add(&r->hist[i], t[i + 1] - t[i]);
+	hist_add(&r->hist[STAGE_TOTAL], t[STAGE_TOTAL] - t[STAGE_PHY]);
+}
+
+/* return number of frames */
+static int replay_pass(struct replay* r, struct uwifi_pcap_file* pf, bool timed)
+{
+	struct uwifi_pcap_frame f;
+	int num = 0;
+	int ret;
+
+	/* every pass replays the capture from an empty state */
+	uwifi_nodes_init(&r->nodes);
+	uwifi_essids_init(&r->essids);
+	uwifi_ssid_table_init(&r->ssids);
+	r->essids.ssids = &r->ssids;
+	uwifi_beacon_cache_init(&r->beacons);
+	memset(&r->intf, 0, sizeof(r->intf));
+	r->intf.channel_idx = -1;
+
+	uwifi_pcap_rewind(pf);
+	if (timed) {
+		while ((ret = uwifi_pcap_next(pf, &f)) > 0) {
+			replay_frame(r, &f);
+			num++;
+		}
+	} else {
+		ret = num = uwifi_pcap_replay(pf, &r->nodes, &r->essids, UWIFI_PARSE_FULL, 0);
+	}
+
+	uwifi_nodes_free(&r->nodes);
+	uwifi_essids_free(&r->essids);
+	uwifi_ssid_table_free(&r->ssids);
+	uwifi_beacon_cache_free(&r->beacons);
+	return ret < 0 ? -1 : num;
+}
+
+static uint64_t timer_overhead(void)
+{
+	uint64_t start = now_ns();
+	int i;
+
+	for (i = 0; i < 100000; i++)
+		now_ns();
+	return (now_ns() - start) / 100000;
+}
+
+int main(int argc, char** argv)
+{
+	struct uwifi_pcap_file pf;
+	static struct replay r;
+	uint64_t start, ns = 0;
+	unsigned long total = 0;
+	int iter, i, num;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <file.pcap|file.pcapng> [iterations]\n", argv[0]);
+		return 1;
+	}
+	iter = argc > 2 ? atoi(argv[2]) : 10;
+	if (iter <= 0)
+		iter = 1;
+
+	if (!uwifi_pcap_open(&pf, argv[1])) {
+		fprintf(stderr, "can't open %s\n", argv[1]);
+		return 1;
+	}
+
+	for (i = 0; i < iter; i++) {
+		start = now_ns();
+		num = replay_pass(&r, &pf, false);
+		ns += now_ns() - start;
+		if (num < 0) {
+			fprintf(stderr, "error reading %s\n", argv[1]);
+			uwifi_pcap_close(&pf);
+			return 1;
+		}
+		total += num;
+	}
+
+	printf("%s: %d frames, %d iterations\n", argv[1], num, iter);
+	printf("throughput %.1f ns/frame, %.3f Mframes/s (untimed)\n",
+	       total ? (double)ns / total : 0.0, ns ? total * 1000.0 / ns : 0.0);
+	printf("timer overhead %lu ns\n\n", (unsigned long)timer_overhead());
+
+	for (i = 0; i < iter; i++)
+		replay_pass(&r, &pf, true);
+
+	printf("%-14s %10s %8s %8s %8s %8s %8s\n",
+	       "stage (ns)", "frames", "mean", "p50", "p99", "p999", "max");
+	for (i = 0; i < STAGE_MAX; i++) {
+		struct hist* h = &r.hist[i];
+		if (h->num == 0)
+			continue;
+		printf("%-14s %10lu %8.1f %8lu %8lu %8lu %8lu\n", stage_names[i],
+		       (unsigned long)h->num, (double)h->sum / h->num,
+		       (unsigned long)hist_percentile(h, 0.5),
+		       (unsigned long)hist_percentile(h, 0.99),
+		       (unsigned long)hist_percentile(h, 0.999),
+		       (unsigned long)h->max);
+	}
+
+	uwifi_pcap_close(&pf);
+	return 0;
+}
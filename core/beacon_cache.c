@@ -0,0 +1,226 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+#include "wlan80211.h"
+#include "wlan_parser.h"
+#include "beacon_cache.h"
+#include "stats.h"
+#include "log.h"
+
+#define BEACON_CACHE_MIN_SIZE	32
+
+void uwifi_beacon_cache_init(struct uwifi_beacon_cache* bc)
+{
+	memset(bc, 0, sizeof(*bc));
+}
+
+void uwifi_beacon_cache_free(struct uwifi_beacon_cache* bc)
+{
+	unsigned int max = bc->max;
+	unsigned int i;
+
+	for (i = 0; i < bc->num; i++)
+		free(bc->entries[i].ies);
+	free(bc->entries);
+	mac_hash_free(&bc->idx);
+	memset(bc, 0, sizeof(*bc));
+	bc->max = max;
+}
+
+/* find the TIM in the IE index of a freshly parsed beacon */
+static void entry_find_tim(struct uwifi_beacon_entry* e, const struct uwifi_packet* p)
+{
+	int i;
+
+	e->tim_off = UINT16_MAX;
+	e->tim_len = 0;
+	for (i = 0; i < p->wlan_ie_num; i++) {
+		if (p->wlan_ie_idx[i].id == WLAN_IE_ID_TIM) {
+			e->tim_off = p->wlan_ie_idx[i].off;
+			e->tim_len = p->wlan_ie_idx[i].len;
+			return;
+		}
+	}
+}
+
+/* compare all IEs except the TIM at the position remembered in @e, so no IE
+ * walk is needed. A TIM which is not indexed is compared too, so it only costs
+ * hits. The lengths have to be equal already */
+static bool ies_equal(const struct uwifi_beacon_entry* e, const unsigned char* buf,
+		      size_t len)
+{
+	size_t tim_end;
+
+	if (e->tim_off == UINT16_MAX)
+		return memcmp(e->ies, buf, len) == 0;
+
+	tim_end = e->tim_off + 2 + e->tim_len;
+	return buf[e->tim_off] == WLAN_IE_ID_TIM && buf[e->tim_off + 1] == e->tim_len &&
+	       memcmp(e->ies, buf, e->tim_off) == 0 &&
+	       memcmp(e->ies + tim_end, buf + tim_end, len - tim_end) == 0;
+}
+
+static void entry_store(struct uwifi_beacon_entry* e, const unsigned char* ies,
+			size_t len, const struct uwifi_packet* p)
+{
+	unsigned char* buf;
+
+	if (e->ies == NULL || e->ie_len != len) {
+		buf = realloc(e->ies, len > 0 ? len : 1);
+		if (buf == NULL) {
+			/* never hits */
+			free(e->ies);
+			e->ies = NULL;
+			return;
+		}
+		e->ies = buf;
+	}
+	memcpy(e->ies, ies, len);
+	e->ie_len = len;
+
+	e->essid_off = p->wlan_essid != NULL ?
+		       (const unsigned char*)p->wlan_essid - ies : UINT16_MAX;
+	e->essid_len = p->wlan_essid_len;
+	e->channel = p->wlan_channel;
+	e->channel_6g = p->wlan_6g_channel;
+	e->chan_width = p->wlan_chan_width;
+	e->tx_streams = p->wlan_tx_streams;
+	e->rx_streams = p->wlan_rx_streams;
+	e->wpa = p->wlan_wpa;
+	e->rsn = p->wlan_rsn;
+	e->ht40plus = p->wlan_ht40plus;
+	e->bss_color = p->wlan_bss_color;
+	e->he = p->wlan_he;
+	e->eht = p->wlan_eht;
+	e->ie_truncated = p->wlan_ie_truncated;
+	e->ie_num = p->wlan_ie_num;
+	entry_find_tim(e, p);
+}
+
+static void entry_load(struct uwifi_beacon_entry* e, const unsigned char* ies,
+		       struct uwifi_packet* p)
+{
+	/* the SSID is referenced in this frame, not in the cached copy */
+	p->wlan_essid = e->essid_off != UINT16_MAX ?
+			(const char*)ies + e->essid_off : NULL;
+	p->wlan_essid_len = e->essid_len;
+	p->wlan_channel = e->channel;
+	p->wlan_6g_channel = e->channel_6g;
+	p->wlan_chan_width = e->chan_width;
+	p->wlan_tx_streams = e->tx_streams;
+	p->wlan_rx_streams = e->rx_streams;
+	p->wlan_wpa = e->wpa;
+	p->wlan_rsn = e->rsn;
+	p->wlan_ht40plus = e->ht40plus;
+	p->wlan_bss_color = e->bss_color;
+	p->wlan_he = e->he;
+	p->wlan_eht = e->eht;
+	p->wlan_ies = ies;
+	p->wlan_ie_truncated = e->ie_truncated;
+	p->wlan_ie_num = e->ie_num;
+	p->wlan_ie_idx = e->ie_idx;
+}
+
+/* second chance: skip entries which were hit since the last sweep */
+static unsigned int entry_evict(struct uwifi_beacon_cache* bc)
+{
+	struct uwifi_beacon_entry* e;
+	unsigned int i;
+
+	for (;;) {
+		i = bc->hand;
+		bc->hand = (bc->hand + 1) % bc->num;
+		e = &bc->entries[i];
+		if (!e->used)
+			break;
+		e->used = false;
+	}
+
+	/* may have been removed already when reusing it failed */
+	if ((uintptr_t)mac_hash_get(&bc->idx, e->key) == i + 1)
+		mac_hash_del(&bc->idx, e->key);
+	bc->evictions++;
+	return i;
+}
+
+static struct uwifi_beacon_entry* entry_add(struct uwifi_beacon_cache* bc, uint64_t key)
+{
+	unsigned int max = bc->max ? bc->max : UWIFI_BEACON_CACHE_MAX;
+	struct uwifi_beacon_entry* e;
+	unsigned int i;
+
+	if (bc->num >= max) {
+		i = entry_evict(bc);
+	} else {
+		if (bc->num == bc->size) {
+			unsigned int size = bc->size ? bc->size * 2 : BEACON_CACHE_MIN_SIZE;
+			if (size > max)
+				size = max;
+			e = realloc(bc->entries, size * sizeof(struct uwifi_beacon_entry));
+			if (e == NULL)
+				return NULL;
+			bc->entries = e;
+			bc->size = size;
+		}
+		i = bc->num;
+		bc->entries[i].ies = NULL;	/* evicted entries keep theirs */
+	}
+
+	if (!mac_hash_put(&bc->idx, key, (void*)(uintptr_t)(i + 1)))
+		return NULL;
+	if (i == bc->num)
+		bc->num++;
+
+	e = &bc->entries[i];
+	e->key = key;
+	e->used = false;
+	return e;
+}
+
+bool uwifi_beacon_cache_parse(struct uwifi_beacon_cache* bc, const unsigned char* bssid,
+			      unsigned char* ies, size_t len, struct uwifi_packet* p)
+{
+	uint64_t key = mac_to_u64(bssid);
+	unsigned int i = (uintptr_t)mac_hash_get(&bc->idx, key);
+	struct uwifi_beacon_entry* e = i > 0 ? &bc->entries[i - 1] : NULL;
+
+	/* also catches a negative length from a short frame */
+	if (len > UINT16_MAX) {
+		uwifi_parse_information_elements(ies, len, p);
+		return false;
+	}
+
+	if (e != NULL && e->ies != NULL && e->ie_len == len && ies_equal(e, ies, len)) {
+		entry_load(e, ies, p);
+		e->used = true;
+		bc->hits++;
+		UWIFI_STAT_INC(beacon_cache_hits);
+		return true;
+	}
+
+	if (e == NULL)
+		e = entry_add(bc, key);
+	/* index directly into the entry, without one only the caller's */
+	if (e != NULL)
+		p->wlan_ie_idx = e->ie_idx;
+
+	uwifi_parse_information_elements(ies, len, p);
+	bc->misses++;
+	UWIFI_STAT_INC(beacon_cache_misses);
+
+	if (e != NULL) {
+		LOG_DBG("BEACON cache update " MAC_FMT, MAC_PAR(bssid));
+		entry_store(e, ies, len, p);
+	}
+	return false;
+}
@@ -15,6 +15,7 @@
 #include "channel.h"
 #include "wlan_util.h"
 #include "conf.h"
+#include "stats.h"
 #include "log.h"
 
 uint32_t uwifi_channel_get_remaining_dwell_time(struct uwifi_interface* intf)
@@ -22,7 +23,8 @@ uint32_t uwifi_channel_get_remaining_dwell_time(struct uwifi_interface* intf)
 	if (!intf->channel_scan)
 		return UINT32_MAX;
 
-	int64_t ret = (int64_t)intf->channel_time - (plat_time_usec() - intf->last_channelchange);
+	int64_t ret = (int64_t)intf->channel_time -
+		      (int64_t)(plat_time_ns_coarse() - intf->last_channelchange) / 1000;
 
 	if (ret < 0)
 		return 0;
@@ -111,6 +113,7 @@ const char* uwifi_channel_width_string(enum uwifi_chan_width w)
 		case CHAN_WIDTH_80: return "VHT80";
 		case CHAN_WIDTH_160: return "VHT160";
 		case CHAN_WIDTH_8080: return "VHT80+80";
+		case CHAN_WIDTH_320: return "EHT320";
 	}
 	return "";
 }
@@ -125,6 +128,7 @@ const char* uwifi_channel_width_string_short(enum uwifi_chan_width w, int ht40p)
 		case CHAN_WIDTH_80: return "80";
 		case CHAN_WIDTH_160: return "160";
 		case CHAN_WIDTH_8080: return "80+80";
+		case CHAN_WIDTH_320: return "320";
 	}
 	return "";
 }
@@ -136,6 +140,7 @@ enum uwifi_chan_width uwifi_channel_width_from_mhz(int width)
 		case 40: return CHAN_WIDTH_40;
 		case 80: return CHAN_WIDTH_80;
 		case 160: return CHAN_WIDTH_160;
+		case 320: return CHAN_WIDTH_320;
 	}
 	return CHAN_WIDTH_UNSPEC;
 }
@@ -234,24 +239,27 @@ bool uwifi_channel_change(struct uwifi_interface* intf, struct uwifi_chan_spec*
 	 * if someone tries invalid HT40+/- channels */
 	if (spec->center_freq == 0 && !(spec->width == CHAN_WIDTH_20_NOHT || spec->width == CHAN_WIDTH_20)) {
 		LOG_ERR("%s not valid", uwifi_channel_get_string(spec));
+		UWIFI_STAT_INC(chan_change_fail);
 		return false;
 	}
 
-	uint32_t the_time = plat_time_usec();
+	uint64_t the_time = plat_time_ns();
 
 	if (!ifctrl_iwset_freq(intf->ifname, spec->freq, spec->width, spec->center_freq)) {
 		LOG_ERR("Failed to set %s after %dms", uwifi_channel_get_string(spec),
-			(the_time - intf->last_channelchange) / 1000);
+			(int)((the_time - intf->last_channelchange) / 1000000));
+		UWIFI_STAT_INC(chan_change_fail);
 		return false;
 	}
 
 	LOG_DBG("Set %s after %dms", uwifi_channel_get_string(spec),
-		(the_time - intf->last_channelchange) / 1000);
+		(int)((the_time - intf->last_channelchange) / 1000000));
 
 	intf->channel_idx = uwifi_channel_idx_from_freq(&intf->channels, spec->freq);
 	intf->channel = *spec;
 	intf->max_phy_rate = wlan_max_phy_rate(spec->width, channel_get_band_from_idx(&intf->channels, intf->channel_idx).streams_rx);
 	intf->last_channelchange = the_time;
+	UWIFI_STAT_INC(chan_changes);
 	return true;
 }
 
@@ -351,7 +359,7 @@ int uwifi_channel_auto_change(struct uwifi_interface* intf)
 	 * channels all the time. also we hope the application reacts to the -1
 	 * error code */
 	if (ret != 1) {
-		intf->last_channelchange = plat_time_usec();
+		intf->last_channelchange = plat_time_ns();
 		return -1;
 	}
 
@@ -400,7 +408,7 @@ bool uwifi_channel_init(struct uwifi_interface* intf)
 	ifctrl_iwget_freqlist(intf);
 	intf->channel_initialized = 1;
 	intf->channel_idx = -1;
-	intf->last_channelchange = plat_time_usec();
+	intf->last_channelchange = plat_time_ns();
 
 	//LOG_INF("Got %d Bands, %d Channels:", intf->channels.num_bands, intf->channels.num_channels);
 	for (int i = 0; i < intf->channels.num_channels && i < MAX_CHANNELS; i++) {
@@ -15,34 +15,202 @@
 #include "node.h"
 #include "util.h"
 #include "essid.h"
+#include "ssid_table.h"
 #include "log.h"
 
-static void update_essid_split_status(struct essid_info* e)
+#define ESSID_IDX_MIN_SIZE	16
+
+void uwifi_essids_init(struct uwifi_essids* essids)
 {
-	struct uwifi_node* n;
-	unsigned char* last_bssid = NULL;
+	cc_list_head_init(&essids->list);
+	essids->pool = NULL;
+	essids->idx = NULL;
+	essids->idx_size = 0;
+	essids->num = 0;
+	essids->by_id = NULL;
+	essids->by_id_size = 0;
+	essids->ssids = NULL;
+}
 
-	e->split = 0;
+static struct essid_info* essid_alloc(struct uwifi_essids* essids)
+{
+	struct essid_info* e;
 
-	/* essid can't be split if it only contains 1 node */
-	if (e->num_nodes <= 1)
-		return;
+	if (essids->pool != NULL)
+		return uwifi_pool_alloc(essids->pool);
+
+	e = malloc(sizeof(struct essid_info));
+	if (e != NULL)
+		memset(e, 0, sizeof(struct essid_info));
+	return e;
+}
+
+static void essid_free(struct essid_info* e)
+{
+	mac_hash_free(&e->bssids);
+	if (e->essids->pool != NULL)
+		uwifi_pool_free(e->essids->pool, e);
+	else
+		free(e);
+}
+
+/*
+ * Hash index
+ */
+
+static struct essid_info* essid_idx_find(struct uwifi_essids* essids, const char* essid,
+					 unsigned int len, uint32_t hash)
+{
+	struct essid_info* e;
+
+	if (essids->idx == NULL)
+		return NULL;
+
+	for (e = essids->idx[hash & (essids->idx_size - 1)]; e != NULL; e = e->hnext) {
+		if (e->hash == hash && e->essid_len == len &&
+		    memcmp(e->essid, essid, len) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+static bool essid_idx_resize(struct uwifi_essids* essids, unsigned int size)
+{
+	struct essid_info** idx;
+	struct essid_info* e;
+	unsigned int b;
+
+	idx = calloc(size, sizeof(struct essid_info*));
+	if (idx == NULL)
+		return false;
+
+	cc_list_for_each(&essids->list, e, list) {
+		b = e->hash & (size - 1);
+		e->hnext = idx[b];
+		idx[b] = e;
+	}
+
+	free(essids->idx);
+	essids->idx = idx;
+	essids->idx_size = size;
+	return true;
+}
+
+/* add to index, e has to be on the list already */
+static bool essid_idx_add(struct uwifi_essids* essids, struct essid_info* e)
+{
+	unsigned int b;
+
+	/* keep chains short, on average below one entry. resizing relinks
+	 * everything on the list, including e */
+	if (essids->num >= essids->idx_size) {
+		if (!essid_idx_resize(essids, essids->idx_size ? essids->idx_size * 2
+							       : ESSID_IDX_MIN_SIZE))
+			return false;
+		essids->num++;
+		return true;
+	}
 
-	cc_list_for_each(&e->nodes, n, essid_nodes) {
-		LOG_DBG("ESSID SPLIT check node %p src " MAC_FMT " bssid " MAC_FMT,
-			n, MAC_PAR(n->wlan_src), MAC_PAR(n->wlan_bssid));
+	b = e->hash & (essids->idx_size - 1);
+	e->hnext = essids->idx[b];
+	essids->idx[b] = e;
+	essids->num++;
+	return true;
+}
+
+static void essid_idx_del(struct uwifi_essids* essids, struct essid_info* e)
+{
+	struct essid_info** pe = &essids->idx[e->hash & (essids->idx_size - 1)];
+
+	if (e->ssid_id != 0 && e->ssid_id < essids->by_id_size)
+		essids->by_id[e->ssid_id] = NULL;
+
+	for (; *pe != NULL; pe = &(*pe)->hnext) {
+		if (*pe == e) {
+			*pe = e->hnext;
+			essids->num--;
+			return;
+		}
+	}
+}
 
-		if (n->wlan_mode & WLAN_MODE_AP || n->wlan_mode & WLAN_MODE_PROBE)
-			continue;
+static struct essid_info* essid_find_id(struct uwifi_essids* essids, uint32_t id)
+{
+	return id < essids->by_id_size ? essids->by_id[id] : NULL;
+}
 
-		if (last_bssid && memcmp(last_bssid, n->wlan_bssid, WLAN_MAC_LEN) != 0)
-			e->split = 1;
+static void essid_set_id(struct uwifi_essids* essids, struct essid_info* e, uint32_t id)
+{
+	struct essid_info** by_id;
+	unsigned int size;
 
-		last_bssid = n->wlan_bssid;
+	if (id >= essids->by_id_size) {
+		for (size = essids->by_id_size ? essids->by_id_size : 64; size <= id; size *= 2)
+			;
+		by_id = realloc(essids->by_id, size * sizeof(struct essid_info*));
+		if (by_id == NULL)
+			return;
+		memset(by_id + essids->by_id_size, 0,
+		       (size - essids->by_id_size) * sizeof(struct essid_info*));
+		essids->by_id = by_id;
+		essids->by_id_size = size;
 	}
+	essids->by_id[id] = e;
+	e->ssid_id = id;
+}
+
+/*
+ * Split detection: an ESSID is split when its non-AP nodes (IBSS) use more
+ * than one BSSID. Each node remembers what it contributed to the per-BSSID
+ * counts, so an update only touches the counts of that node.
+ */
+
+static void essid_bssid_count(struct essid_info* e, uint64_t bssid, int inc)
+{
+	uintptr_t cnt = (uintptr_t)mac_hash_get(&e->bssids, bssid);
 
-	if (e->split > 0)
+	cnt += inc;
+	if (cnt == 0)
+		mac_hash_del(&e->bssids, bssid);
+	else
+		mac_hash_put(&e->bssids, bssid, (void*)cnt);
+}
+
+static void update_essid_split_status(struct essid_info* e)
+{
+	int split = e->bssids.num > 1;
+
+	if (split && !e->split)
 		LOG_INF("ESSID SPLIT detected");
+	e->split = split;
+}
+
+static void essid_node_uncount(struct essid_info* e, struct uwifi_node* n)
+{
+	if (!n->essid_counted)
+		return;
+	essid_bssid_count(e, n->essid_bssid, -1);
+	n->essid_counted = false;
+}
+
+/* sync what the node contributes with its current mode and BSSID */
+static void essid_node_count(struct essid_info* e, struct uwifi_node* n)
+{
+	bool counted = !(n->wlan_mode & WLAN_MODE_AP || n->wlan_mode & WLAN_MODE_PROBE);
+	uint64_t bssid = mac_to_u64(n->wlan_bssid);
+
+	LOG_DBG("ESSID SPLIT check node %p src " MAC_FMT " bssid " MAC_FMT,
+		n, MAC_PAR(n->wlan_src), MAC_PAR(n->wlan_bssid));
+
+	if (counted == n->essid_counted && (!counted || bssid == n->essid_bssid))
+		return;
+
+	essid_node_uncount(e, n);
+	if (counted) {
+		essid_bssid_count(e, bssid, 1);
+		n->essid_bssid = bssid;
+		n->essid_counted = true;
+	}
 }
 
 void uwifi_essids_remove_node(struct uwifi_node* n)
@@ -54,59 +222,62 @@ void uwifi_essids_remove_node(struct uwifi_node* n)
 	/* first remove ESSID from node */
 	LOG_DBG("ESSID remove node " MAC_FMT, MAC_PAR(n->wlan_src));
 	cc_list_del_from(&e->nodes, &n->essid_nodes);
+	essid_node_uncount(e, n);
 	n->essid = NULL;
 
 	/* then deal with ESSID itself */
-	LOG_DBG("ESSID remove mark 2");
 	e->num_nodes--;
 
 	/* delete essid if it has no more nodes */
 	if (e->num_nodes == 0) {
 		LOG_DBG("ESSID empty, delete");
+		essid_idx_del(e->essids, e);
 		cc_list_del(&e->list);
-		free(e);
+		essid_free(e);
 	} else {
-		LOG_DBG("ESSID remove mark 1");
 		update_essid_split_status(e);
 	}
 }
 
-void uwifi_essids_update(struct cc_list_head* essids, struct uwifi_packet* p,
-			 struct uwifi_node* n)
+/* find ESSID or add a new one */
+static struct essid_info* essid_get(struct uwifi_essids* essids, const char* essid,
+				    unsigned int len)
 {
 	struct essid_info* e;
+	uint32_t hash;
 
-	if (n == NULL || p == NULL || p->phy_flags & PHY_FLAG_BADFCS ||
-	    p->wlan_essid[0] == '\0')
-		return; /* ignore */
-
-	/* only check beacons and probe response frames */
-	if (p->wlan_type != WLAN_FRAME_BEACON &&
-	    p->wlan_type != WLAN_FRAME_PROBE_RESP)
-		return;
-
-	LOG_DBG("ESSID check '%s' node " MAC_FMT " bssid " MAC_FMT,
-		p->wlan_essid, MAC_PAR(n->wlan_src), MAC_PAR(p->wlan_bssid));
+	if (len > WLAN_MAX_SSID_LEN - 1)
+		len = WLAN_MAX_SSID_LEN - 1;
+	hash = uwifi_ssid_hash(essid, len);
 
 	/* find essid if already recorded */
-	cc_list_for_each(essids, e, list) {
-		if (strncmp(e->essid, p->wlan_essid, WLAN_MAX_SSID_LEN) == 0) {
-			LOG_DBG("ESSID found");
-			break;
-		}
-	}
+	e = essid_idx_find(essids, essid, len, hash);
 
 	/* if not add new essid */
-	if (&e->list == &essids->n) {
+	if (e == NULL) {
 		LOG_DBG("ESSID not found, adding new");
-		e = malloc(sizeof(struct essid_info));
-		memset(e, 0, sizeof(struct essid_info));
-		strncpy(e->essid, p->wlan_essid, WLAN_MAX_SSID_LEN);
-		e->essid[WLAN_MAX_SSID_LEN-1] = '\0';
-		      cc_list_head_init(&e->nodes);
-		cc_list_add_tail(essids, &e->list);
+		e = essid_alloc(essids);
+		if (e == NULL)
+			return NULL;
+		memcpy(e->essid, essid, len);
+		e->essid[len] = '\0';
+		e->essid_len = len;
+		e->hash = hash;
+		e->essids = essids;
+		cc_list_head_init(&e->nodes);
+		cc_list_add_tail(&essids->list, &e->list);
+		if (!essid_idx_add(essids, e)) {
+			cc_list_del(&e->list);
+			essid_free(e);
+			return NULL;
+		}
 	}
+	return e;
+}
 
+/* add node to ESSID and update split status */
+static void essid_add_node(struct essid_info* e, struct uwifi_node* n)
+{
 	/* if node had another essid before, remove it there */
 	if (n->essid != NULL && n->essid != e) {
 		LOG_DBG("ESSID remove old '%s'", n->essid->essid);
@@ -120,17 +291,75 @@ void uwifi_essids_update(struct cc_list_head* essids, struct uwifi_packet* p,
 		cc_list_add_tail(&e->nodes, &n->essid_nodes);
 		e->num_nodes++;
 		n->essid = e;
+		n->essid_counted = false;
 	}
 
+	essid_node_count(e, n);
 	update_essid_split_status(e);
 }
 
-void uwifi_essids_free(struct cc_list_head* essids) {
+void uwifi_essids_update(struct uwifi_essids* essids, struct uwifi_packet* p,
+			 struct uwifi_node* n)
+{
+	struct essid_info* e;
+
+	if (n == NULL || p == NULL || p->phy_flags & PHY_FLAG_BADFCS ||
+	    p->wlan_essid_len == 0 || p->wlan_essid[0] == '\0')
+		return; /* ignore */
+
+	/* only check beacons and probe response frames */
+	if (p->wlan_type != WLAN_FRAME_BEACON &&
+	    p->wlan_type != WLAN_FRAME_PROBE_RESP)
+		return;
+
+	LOG_DBG("ESSID check '%.*s' node " MAC_FMT " bssid " MAC_FMT,
+		p->wlan_essid_len, p->wlan_essid, MAC_PAR(n->wlan_src),
+		MAC_PAR(p->wlan_bssid));
+
+	if (p->wlan_ssid_id == 0 && essids->ssids != NULL)
+		uwifi_ssid_intern_packet(essids->ssids, p);
+
+	/* interned SSIDs don't need to be hashed and compared again */
+	e = essid_find_id(essids, p->wlan_ssid_id);
+	if (e == NULL) {
+		e = essid_get(essids, p->wlan_essid, p->wlan_essid_len);
+		if (e == NULL)
+			return;
+		if (p->wlan_ssid_id != 0 && e->ssid_id == 0)
+			essid_set_id(essids, e, p->wlan_ssid_id);
+	}
+
+	essid_add_node(e, n);
+}
+
+void uwifi_essids_add_node(struct uwifi_essids* essids, const char* essid,
+			   struct uwifi_node* n)
+{
+	uwifi_essids_add_node_len(essids, essid, strnlen(essid, WLAN_MAX_SSID_LEN - 1), n);
+}
+
+void uwifi_essids_add_node_len(struct uwifi_essids* essids, const char* essid,
+			       unsigned int len, struct uwifi_node* n)
+{
+	struct essid_info* e = essid_get(essids, essid, len);
+
+	if (e != NULL)
+		essid_add_node(e, n);
+}
+
+void uwifi_essids_free(struct uwifi_essids* essids) {
 	struct essid_info *e, *f;
 
-	cc_list_for_each_safe(essids, e, f, list) {
+	cc_list_for_each_safe(&essids->list, e, f, list) {
 		LOG_DBG("ESSID free '%s'", e->essid);
-		cc_list_del_from(essids, &e->list);
-		free(e);
+		cc_list_del_from(&essids->list, &e->list);
+		essid_free(e);
 	}
+	free(essids->idx);
+	essids->idx = NULL;
+	essids->idx_size = 0;
+	essids->num = 0;
+	free(essids->by_id);
+	essids->by_id = NULL;
+	essids->by_id_size = 0;
 }
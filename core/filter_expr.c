@@ -0,0 +1,585 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "filter_expr.h"
+#include "wlan_parser.h"
+#include "node.h"
+#include "essid.h"
+#include "log.h"
+
+/*
+ * The bytecode has one boolean result register. Comparisons set it, NOT
+ * inverts it and the jumps implement short circuit && and ||: "a && b" is
+ * "a; JF end; b; end:" and the register already holds the result when
+ * jumping.
+ */
+enum expr_op {
+	OP_CMP_INT,
+	OP_CMP_MAC,
+	OP_CMP_STR,
+	OP_NOT,
+	OP_JF,		/* jump if false */
+	OP_JT,		/* jump if true */
+};
+
+enum expr_cmp {
+	CMP_EQ,
+	CMP_NE,
+	CMP_LT,
+	CMP_LE,
+	CMP_GT,
+	CMP_GE,
+	CMP_AND,	/* bits set */
+	CMP_GLOB,
+};
+
+enum expr_kind {
+	KIND_INT,
+	KIND_MAC,
+	KIND_STR,
+};
+
+enum expr_field {
+	F_TYPE, F_CLASS, F_SIGNAL, F_RATE, F_FREQ, F_CHANNEL, F_LEN, F_MODE,
+	F_SEQNO, F_RETRY, F_WEP, F_WPA, F_RSN, F_WIDTH, F_TX_STREAMS,
+	F_RX_STREAMS, F_BINTVAL, F_QOS, F_NAV, F_INJECTED, F_BADFCS,
+	F_TA, F_RA, F_BSSID, F_ESSID,
+	F_NODE_PKTS, F_NODE_MODE, F_NODE_CHANNEL, F_NODE_STD, F_NODE_SIG_MAX,
+	F_NODE_RETRIES, F_NODE_ESSID,
+};
+
+#define F_NODE_FIRST	F_NODE_PKTS
+
+static const struct {
+	const char*	name;
+	uint8_t		field;
+	uint8_t		kind;
+} fields[] = {
+	{ "type",		F_TYPE,		KIND_INT },
+	{ "class",		F_CLASS,	KIND_INT },
+	{ "signal",		F_SIGNAL,	KIND_INT },
+	{ "rate",		F_RATE,		KIND_INT },
+	{ "freq",		F_FREQ,		KIND_INT },
+	{ "channel",		F_CHANNEL,	KIND_INT },
+	{ "len",		F_LEN,		KIND_INT },
+	{ "mode",		F_MODE,		KIND_INT },
+	{ "seqno",		F_SEQNO,	KIND_INT },
+	{ "retry",		F_RETRY,	KIND_INT },
+	{ "wep",		F_WEP,		KIND_INT },
+	{ "wpa",		F_WPA,		KIND_INT },
+	{ "rsn",		F_RSN,		KIND_INT },
+	{ "width",		F_WIDTH,	KIND_INT },
+	{ "tx_streams",		F_TX_STREAMS,	KIND_INT },
+	{ "rx_streams",		F_RX_STREAMS,	KIND_INT },
+	{ "bintval",		F_BINTVAL,	KIND_INT },
+	{ "qos",		F_QOS,		KIND_INT },
+	{ "nav",		F_NAV,		KIND_INT },
+	{ "injected",		F_INJECTED,	KIND_INT },
+	{ "badfcs",		F_BADFCS,	KIND_INT },
+	{ "ta",			F_TA,		KIND_MAC },
+	{ "ra",			F_RA,		KIND_MAC },
+	{ "bssid",		F_BSSID,	KIND_MAC },
+	{ "essid",		F_ESSID,	KIND_STR },
+	{ "node.pkts",		F_NODE_PKTS,	KIND_INT },
+	{ "node.mode",		F_NODE_MODE,	KIND_INT },
+	{ "node.channel",	F_NODE_CHANNEL,	KIND_INT },
+	{ "node.std",		F_NODE_STD,	KIND_INT },
+	{ "node.sig_max",	F_NODE_SIG_MAX,	KIND_INT },
+	{ "node.retries",	F_NODE_RETRIES,	KIND_INT },
+	{ "node.essid",		F_NODE_ESSID,	KIND_STR },
+};
+
+static const struct {
+	const char*	name;
+	int		val;
+} names[] = {
+	{ "beacon",		WLAN_FRAME_BEACON },
+	{ "probe_req",		WLAN_FRAME_PROBE_REQ },
+	{ "probe_resp",		WLAN_FRAME_PROBE_RESP },
+	{ "auth",		WLAN_FRAME_AUTH },
+	{ "deauth",		WLAN_FRAME_DEAUTH },
+	{ "assoc_req",		WLAN_FRAME_ASSOC_REQ },
+	{ "assoc_resp",		WLAN_FRAME_ASSOC_RESP },
+	{ "reassoc_req",	WLAN_FRAME_REASSOC_REQ },
+	{ "reassoc_resp",	WLAN_FRAME_REASSOC_RESP },
+	{ "disassoc",		WLAN_FRAME_DISASSOC },
+	{ "action",		WLAN_FRAME_ACTION },
+	{ "data",		WLAN_FRAME_DATA },
+	{ "qdata",		WLAN_FRAME_QDATA },
+	{ "null",		WLAN_FRAME_NULL },
+	{ "qos_null",		WLAN_FRAME_QOS_NULL },
+	{ "rts",		WLAN_FRAME_RTS },
+	{ "cts",		WLAN_FRAME_CTS },
+	{ "ack",		WLAN_FRAME_ACK },
+	{ "pspoll",		WLAN_FRAME_PSPOLL },
+	{ "blkack",		WLAN_FRAME_BLKACK },
+	{ "blkack_req",		WLAN_FRAME_BLKACK_REQ },
+	/* for class, "data" is the same as WLAN_FRAME_DATA */
+	{ "mgmt",		WLAN_FRAME_FC(WLAN_FRAME_TYPE_MGMT, 0) },
+	{ "ctrl",		WLAN_FRAME_FC(WLAN_FRAME_TYPE_CTRL, 0) },
+	{ "ap",			WLAN_MODE_AP },
+	{ "sta",		WLAN_MODE_STA },
+	{ "ibss",		WLAN_MODE_IBSS },
+	{ "probe",		WLAN_MODE_PROBE },
+	{ "4addr",		WLAN_MODE_4ADDR },
+};
+
+/*
+ * Evaluation
+ */
+
+static bool get_int(uint8_t field, const struct uwifi_packet* p,
+		    const struct uwifi_node* n, int* val)
+{
+	if (field >= F_NODE_FIRST && n == NULL)
+		return false;
+
+	switch (field) {
+	case F_TYPE:		*val = p->wlan_type; break;
+	case F_CLASS:		*val = p->wlan_type & WLAN_FRAME_FC_TYPE_MASK; break;
+	case F_SIGNAL:		*val = p->phy_signal; break;
+	case F_RATE:		*val = p->phy_rate; break;
+	case F_FREQ:		*val = p->phy_freq; break;
+	case F_CHANNEL:		*val = p->wlan_channel; break;
+	case F_LEN:		*val = p->wlan_len; break;
+	case F_MODE:		*val = p->wlan_mode; break;
+	case F_SEQNO:		*val = p->wlan_seqno; break;
+	case F_RETRY:		*val = p->wlan_retry; break;
+	case F_WEP:		*val = p->wlan_wep; break;
+	case F_WPA:		*val = p->wlan_wpa; break;
+	case F_RSN:		*val = p->wlan_rsn; break;
+	case F_WIDTH:		*val = p->wlan_chan_width; break;
+	case F_TX_STREAMS:	*val = p->wlan_tx_streams; break;
+	case F_RX_STREAMS:	*val = p->wlan_rx_streams; break;
+	case F_BINTVAL:		*val = p->wlan_bintval; break;
+	case F_QOS:		*val = p->wlan_qos_class; break;
+	case F_NAV:		*val = p->wlan_nav; break;
+	case F_INJECTED:	*val = p->phy_injected; break;
+	case F_BADFCS:		*val = (p->phy_flags & PHY_FLAG_BADFCS) != 0; break;
+	case F_NODE_PKTS:	*val = n->pkt_count; break;
+	case F_NODE_MODE:	*val = n->wlan_mode; break;
+	case F_NODE_CHANNEL:	*val = n->wlan_channel; break;
+	case F_NODE_STD:	*val = n->wlan_std; break;
+	case F_NODE_SIG_MAX:	*val = n->phy_sig_max; break;
+	case F_NODE_RETRIES:	*val = n->wlan_retries_all; break;
+	default:		return false;
+	}
+	return true;
+}
+
+/* glob with '*' and '?' */
+static bool glob_match(const char* pat, const char* str)
+{
+	const char* star = NULL;
+	const char* back = NULL;
+
+	while (*str) {
+		if (*pat == '*') {
+			star = pat++;
+			back = str;
+		} else if (*pat == '?' || *pat == *str) {
+			pat++;
+			str++;
+		} else if (star != NULL) {
+			pat = star + 1;
+			str = ++back;
+		} else {
+			return false;
+		}
+	}
+	while (*pat == '*')
+		pat++;
+	return *pat == '\0';
+}
+
+bool uwifi_expr_match(const struct uwifi_expr* e, const struct uwifi_packet* p,
+		      const struct uwifi_node* n)
+{
+	const struct uwifi_expr_insn* in;
+	const unsigned char* mac;
+	const char* str;
+	char essid[WLAN_MAX_SSID_LEN];
+	unsigned int pc = 0;
+	bool r = true;
+	int v;
+
+	while (pc < e->num) {
+		in = &e->insn[pc++];
+		switch (in->op) {
+		case OP_CMP_INT:
+			if (!get_int(in->field, p, n, &v)) {
+				r = false;
+				break;
+			}
+			switch (in->cmp) {
+			case CMP_EQ:	r = v == in->val; break;
+			case CMP_NE:	r = v != in->val; break;
+			case CMP_LT:	r = v < in->val; break;
+			case CMP_LE:	r = v <= in->val; break;
+			case CMP_GT:	r = v > in->val; break;
+			case CMP_GE:	r = v >= in->val; break;
+			case CMP_AND:	r = (v & in->val) != 0; break;
+			}
+			break;
+		case OP_CMP_MAC:
+			mac = in->field == F_TA ? p->wlan_ta :
+			      in->field == F_RA ? p->wlan_ra : p->wlan_bssid;
+			r = memcmp(mac, e->consts[in->val].mac, WLAN_MAC_LEN) == 0;
+			if (in->cmp == CMP_NE)
+				r = !r;
+			break;
+		case OP_CMP_STR:
+			if (in->field == F_ESSID) {
+				/* the packet SSID is not NUL terminated */
+				if (p->wlan_essid_len > 0)
+					memcpy(essid, p->wlan_essid, p->wlan_essid_len);
+				essid[p->wlan_essid_len] = '\0';
+				str = essid;
+			} else if (n != NULL && n->essid != NULL)
+				str = n->essid->essid;
+			else {
+				r = false;
+				break;
+			}
+			if (in->cmp == CMP_GLOB)
+				r = glob_match(e->consts[in->val].str, str);
+			else
+				r = strcmp(e->consts[in->val].str, str) == 0;
+			if (in->cmp == CMP_NE)
+				r = !r;
+			break;
+		case OP_NOT:
+			r = !r;
+			break;
+		case OP_JF:
+			if (!r)
+				pc = in->val;
+			break;
+		case OP_JT:
+			if (r)
+				pc = in->val;
+			break;
+		}
+	}
+	return r;
+}
+
+/*
+ * Compiler: recursive descent, emits code directly
+ */
+
+struct expr_parser {
+	struct uwifi_expr*	e;
+	const char*		start;
+	const char*		pos;
+	unsigned int		insn_size;
+	unsigned int		consts_size;
+	bool			err;
+};
+
+static void parse_error(struct expr_parser* ps, const char* msg)
+{
+	if (!ps->err)
+		LOG_ERR("Filter: %s at position %d", msg, (int)(ps->pos - ps->start));
+	ps->err = true;
+}
+
+static int emit(struct expr_parser* ps, uint8_t op, uint8_t field, uint8_t cmp, int32_t val)
+{
+	struct uwifi_expr* e = ps->e;
+	struct uwifi_expr_insn* in;
+
+	if (e->num >= ps->insn_size) {
+		unsigned int size = ps->insn_size ? ps->insn_size * 2 : 16;
+		in = realloc(e->insn, size * sizeof(*in));
+		if (in == NULL) {
+			parse_error(ps, "out of memory");
+			return -1;
+		}
+		e->insn = in;
+		ps->insn_size = size;
+	}
+
+	in = &e->insn[e->num];
+	in->op = op;
+	in->field = field;
+	in->cmp = cmp;
+	in->val = val;
+	return e->num++;
+}
+
+static struct uwifi_expr_const* new_const(struct expr_parser* ps, int* idx)
+{
+	struct uwifi_expr* e = ps->e;
+	struct uwifi_expr_const* c;
+
+	if (e->num_consts >= ps->consts_size) {
+		unsigned int size = ps->consts_size ? ps->consts_size * 2 : 4;
+		c = realloc(e->consts, size * sizeof(*c));
+		if (c == NULL) {
+			parse_error(ps, "out of memory");
+			return NULL;
+		}
+		e->consts = c;
+		ps->consts_size = size;
+	}
+
+	*idx = e->num_consts;
+	c = &e->consts[e->num_consts++];
+	memset(c, 0, sizeof(*c));
+	return c;
+}
+
+static void skip_space(struct expr_parser* ps)
+{
+	while (isspace((unsigned char)*ps->pos))
+		ps->pos++;
+}
+
+/* consume token if it matches, words have to end there */
+static bool accept(struct expr_parser* ps, const char* tok)
+{
+	size_t len = strlen(tok);
+
+	skip_space(ps);
+	if (strncmp(ps->pos, tok, len) != 0)
+		return false;
+	if (isalpha((unsigned char)tok[0]) &&
+	    (isalnum((unsigned char)ps->pos[len]) || ps->pos[len] == '_'))
+		return false;
+	ps->pos += len;
+	return true;
+}
+
+static size_t ident_len(const char* s)
+{
+	size_t len = 0;
+
+	while (isalnum((unsigned char)s[len]) || s[len] == '_' || s[len] == '.')
+		len++;
+	return len;
+}
+
+static bool parse_mac(struct expr_parser* ps, uint8_t* mac)
+{
+	const char* s = ps->pos;
+	int i, hi, lo;
+
+	for (i = 0; i < WLAN_MAC_LEN; i++) {
+		if (!isxdigit((unsigned char)s[0]) || !isxdigit((unsigned char)s[1]))
+			return false;
+		hi = isdigit((unsigned char)s[0]) ? s[0] - '0' : tolower((unsigned char)s[0]) - 'a' + 10;
+		lo = isdigit((unsigned char)s[1]) ? s[1] - '0' : tolower((unsigned char)s[1]) - 'a' + 10;
+		mac[i] = hi << 4 | lo;
+		s += 2;
+		if (i < WLAN_MAC_LEN - 1 && *s++ != ':')
+			return false;
+	}
+	ps->pos = s;
+	return true;
+}
+
+static bool parse_int(struct expr_parser* ps, int* val)
+{
+	size_t len;
+	char* end;
+	unsigned int i;
+
+	skip_space(ps);
+	if (isdigit((unsigned char)*ps->pos) || *ps->pos == '-') {
+		*val = strtol(ps->pos, &end, 0);
+		if (end == ps->pos)
+			return false;
+		ps->pos = end;
+		return true;
+	}
+
+	len = ident_len(ps->pos);
+	for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (strlen(names[i].name) == len && strncmp(names[i].name, ps->pos, len) == 0) {
+			*val = names[i].val;
+			ps->pos += len;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parse_string(struct expr_parser* ps, char* str)
+{
+	const char* end;
+
+	skip_space(ps);
+	if (*ps->pos != '"')
+		return false;
+	end = strchr(ps->pos + 1, '"');
+	if (end == NULL || end - ps->pos - 1 >= WLAN_MAX_SSID_LEN)
+		return false;
+	memcpy(str, ps->pos + 1, end - ps->pos - 1);
+	str[end - ps->pos - 1] = '\0';
+	ps->pos = end + 1;
+	return true;
+}
+
+static void parse_or(struct expr_parser* ps);
+
+static void parse_cmp(struct expr_parser* ps)
+{
+	struct uwifi_expr_const* c;
+	unsigned int i;
+	size_t len;
+	int field = -1, kind = 0, cmp, val, idx;
+
+	skip_space(ps);
+	len = ident_len(ps->pos);
+	for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+		if (strlen(fields[i].name) == len && strncmp(fields[i].name, ps->pos, len) == 0) {
+			field = fields[i].field;
+			kind = fields[i].kind;
+			break;
+		}
+	}
+	if (field < 0) {
+		parse_error(ps, "unknown field");
+		return;
+	}
+	ps->pos += len;
+
+	if (accept(ps, "=="))		cmp = CMP_EQ;
+	else if (accept(ps, "!="))	cmp = CMP_NE;
+	else if (accept(ps, "<="))	cmp = CMP_LE;
+	else if (accept(ps, ">="))	cmp = CMP_GE;
+	else if (accept(ps, "<"))	cmp = CMP_LT;
+	else if (accept(ps, ">"))	cmp = CMP_GT;
+	else if (ps->pos[0] == '&' && ps->pos[1] != '&' && accept(ps, "&"))
+		cmp = CMP_AND;
+	else if (accept(ps, "~"))	cmp = CMP_GLOB;
+	else if (kind == KIND_INT) {
+		/* flags like "wpa" alone */
+		emit(ps, OP_CMP_INT, field, CMP_NE, 0);
+		return;
+	} else {
+		parse_error(ps, "expected operator");
+		return;
+	}
+
+	switch (kind) {
+	case KIND_INT:
+		if (cmp == CMP_GLOB || !parse_int(ps, &val)) {
+			parse_error(ps, "expected number");
+			return;
+		}
+		emit(ps, OP_CMP_INT, field, cmp, val);
+		break;
+	case KIND_MAC:
+		skip_space(ps);
+		if ((cmp != CMP_EQ && cmp != CMP_NE) || (c = new_const(ps, &idx)) == NULL ||
+		    !parse_mac(ps, c->mac)) {
+			parse_error(ps, "expected MAC address");
+			return;
+		}
+		emit(ps, OP_CMP_MAC, field, cmp, idx);
+		break;
+	case KIND_STR:
+		if ((cmp != CMP_EQ && cmp != CMP_NE && cmp != CMP_GLOB) ||
+		    (c = new_const(ps, &idx)) == NULL || !parse_string(ps, c->str)) {
+			parse_error(ps, "expected string");
+			return;
+		}
+		emit(ps, OP_CMP_STR, field, cmp, idx);
+		break;
+	}
+}
+
+static void parse_unary(struct expr_parser* ps)
+{
+	if (accept(ps, "!") || accept(ps, "not")) {
+		parse_unary(ps);
+		emit(ps, OP_NOT, 0, 0, 0);
+	} else if (accept(ps, "(")) {
+		parse_or(ps);
+		if (!accept(ps, ")"))
+			parse_error(ps, "expected )");
+	} else {
+		parse_cmp(ps);
+	}
+}
+
+/* patch jumps of a chain to the current end */
+static void patch_jumps(struct expr_parser* ps, unsigned int from, uint8_t op)
+{
+	unsigned int i;
+
+	for (i = from; i < ps->e->num; i++) {
+		if (ps->e->insn[i].op == op && ps->e->insn[i].val == -1)
+			ps->e->insn[i].val = ps->e->num;
+	}
+}
+
+static void parse_and(struct expr_parser* ps)
+{
+	unsigned int start = ps->e->num;
+
+	parse_unary(ps);
+	while (!ps->err && (accept(ps, "&&") || accept(ps, "and"))) {
+		emit(ps, OP_JF, 0, 0, -1);
+		parse_unary(ps);
+	}
+	patch_jumps(ps, start, OP_JF);
+}
+
+static void parse_or(struct expr_parser* ps)
+{
+	unsigned int start = ps->e->num;
+
+	parse_and(ps);
+	while (!ps->err && (accept(ps, "||") || accept(ps, "or"))) {
+		emit(ps, OP_JT, 0, 0, -1);
+		parse_and(ps);
+	}
+	patch_jumps(ps, start, OP_JT);
+}
+
+bool uwifi_expr_compile(struct uwifi_expr* e, const char* str)
+{
+	struct expr_parser ps;
+
+	memset(e, 0, sizeof(*e));
+	memset(&ps, 0, sizeof(ps));
+	ps.e = e;
+	ps.start = ps.pos = str;
+
+	skip_space(&ps);
+	if (*ps.pos == '\0')
+		return true;
+
+	parse_or(&ps);
+	skip_space(&ps);
+	if (!ps.err && *ps.pos != '\0')
+		parse_error(&ps, "unexpected input");
+
+	if (ps.err) {
+		uwifi_expr_free(e);
+		return false;
+	}
+	return true;
+}
+
+void uwifi_expr_free(struct uwifi_expr* e)
+{
+	free(e->insn);
+	free(e->consts);
+	e->insn = NULL;
+	e->consts = NULL;
+	e->num = e->num_consts = 0;
+}
@@ -15,9 +15,145 @@
 #include "wlan80211.h"
 #include "node.h"
 #include "essid.h"
+#include "stats.h"
 #include "log.h"
 
-static void copy_nodeinfo(struct uwifi_node* n, struct uwifi_packet* p)
+void uwifi_nodes_init(struct uwifi_nodes* nodes)
+{
+	cc_list_head_init(&nodes->list);
+	cc_list_head_init(&nodes->lru);
+	memset(&nodes->idx, 0, sizeof(nodes->idx));
+	nodes->pool = NULL;
+	nodes->ext_pool = NULL;
+	nodes->insert_fail = 0;
+}
+
+struct uwifi_node* uwifi_node_find(struct uwifi_nodes* nodes,
+				   const unsigned char* mac)
+{
+	return mac_hash_get(&nodes->idx, mac_to_u64(mac));
+}
+
+static struct uwifi_node* node_alloc(struct uwifi_nodes* nodes)
+{
+	struct uwifi_node* n;
+
+	if (nodes->pool != NULL) {
+		n = uwifi_pool_alloc(nodes->pool);
+	} else {
+		n = (struct uwifi_node*)malloc(sizeof(struct uwifi_node));
+		if (n != NULL)
+			memset(n, 0, sizeof(struct uwifi_node));
+	}
+
+	if (n == NULL)
+		UWIFI_STAT_INC(node_alloc_fail);
+	return n;
+}
+
+static struct uwifi_node_ext* node_ext_alloc(struct uwifi_nodes* nodes)
+{
+	struct uwifi_node_ext* ext;
+
+	if (nodes->ext_pool != NULL)
+		return uwifi_pool_alloc(nodes->ext_pool);
+
+	ext = malloc(sizeof(struct uwifi_node_ext));
+	if (ext != NULL)
+		memset(ext, 0, sizeof(struct uwifi_node_ext));
+	return ext;
+}
+
+static void node_free(struct uwifi_nodes* nodes, struct uwifi_node* n)
+{
+	if (n->ext != NULL && nodes->ext_pool != NULL)
+		uwifi_pool_free(nodes->ext_pool, n->ext);
+	else
+		free(n->ext);
+	if (nodes->pool != NULL)
+		uwifi_pool_free(nodes->pool, n);
+	else
+		free(n);
+}
+
+static struct uwifi_node* node_new(struct uwifi_nodes* nodes,
+				   const unsigned char* mac)
+{
+	struct uwifi_node* n;
+
+	n = node_alloc(nodes);
+	if (n == NULL)
+		goto fail;
+
+	if (!mac_hash_put(&nodes->idx, mac_to_u64(mac), n)) {
+		node_free(nodes, n);
+		goto fail;
+	}
+
+	memcpy(n->wlan_src, mac, WLAN_MAC_LEN);
+	ewma_init(&n->phy_sig_avg, 1024, 8);
+	cc_list_head_init(&n->on_channels);
+	cc_list_head_init(&n->ap_nodes);
+	cc_list_add_tail(&nodes->list, &n->list);
+	cc_list_add_tail(&nodes->lru, &n->lru_list);
+	UWIFI_STAT_INC(node_inserts);
+	return n;
+
+fail:
+	nodes->insert_fail++;
+	return NULL;
+}
+
+/*
+ * Keep the LRU list ordered by last_seen. A node which was just seen normally
+ * goes straight to the tail, the loop only runs for out of order timestamps.
+ */
+static void node_lru_update(struct uwifi_nodes* nodes, struct uwifi_node* n)
+{
+	struct uwifi_node* o;
+
+	cc_list_del(&n->lru_list);
+
+	cc_list_for_each_rev(&nodes->lru, o, lru_list) {
+		if ((int64_t)(n->last_seen - o->last_seen) >= 0) {
+			cc_list_add_after(&nodes->lru, &o->lru_list, &n->lru_list);
+			return;
+		}
+	}
+
+	/* older than all others */
+	cc_list_add(&nodes->lru, &n->lru_list);
+}
+
+static void copy_node_ext(struct uwifi_nodes* nodes, struct uwifi_node* n,
+			  struct uwifi_packet* p)
+{
+	if (n->ext == NULL) {
+		n->ext = node_ext_alloc(nodes);
+		if (n->ext == NULL)
+			return;
+	}
+
+	if (p->ip_src)
+		n->ext->ip_src = p->ip_src;
+	if (p->olsr_tc)
+		n->ext->olsr_tc = p->olsr_tc;
+	if (p->olsr_neigh)
+		n->ext->olsr_neigh = p->olsr_neigh;
+//	if (p->pkt_types & PKT_TYPE_OLSR)
+//		n->ext->olsr_count++;
+	if (p->bat_gw)
+		n->ext->bat_gw = 1;
+}
+
+/* capture time of the packet, saves reading the clock when it is known */
+static inline uint64_t packet_time_ns(const struct uwifi_packet* p)
+{
+	return p->pkt_ts_ns ? p->pkt_ts_ns : plat_time_ns_coarse();
+}
+
+static void copy_nodeinfo(struct uwifi_nodes* nodes, struct uwifi_node* n,
+			  struct uwifi_packet* p)
 {
 	memcpy(n->wlan_src, p->wlan_ta, WLAN_MAC_LEN);
 	n->rx_only = false;
@@ -25,27 +161,24 @@ static void copy_nodeinfo(struct uwifi_node* n, struct uwifi_packet* p)
 	if (MAC_NOT_EMPTY(p->wlan_bssid))
 		memcpy(n->wlan_bssid, p->wlan_bssid, WLAN_MAC_LEN);
 
-	n->last_seen = plat_time_usec();
+	n->last_seen = packet_time_ns(p);
 	n->pkt_count++;
 	n->pkt_types |= p->pkt_types;
-	if (p->ip_src)
-		n->ip_src = p->ip_src;
 	if (p->wlan_mode)
 		n->wlan_mode |= p->wlan_mode;
-	if (p->olsr_tc)
-		n->olsr_tc = p->olsr_tc;
-	if (p->olsr_neigh)
-		n->olsr_neigh = p->olsr_neigh;
-//	if (p->pkt_types & PKT_TYPE_OLSR)
-//		n->olsr_count++;
-	if (p->bat_gw)
-		n->bat_gw = 1;
+	if (p->ip_src || p->olsr_tc || p->olsr_neigh || p->bat_gw)
+		copy_node_ext(nodes, n, p);
 	if (p->wlan_ht40plus)
 		n->wlan_ht40plus = 1;
 	if (p->wlan_tx_streams)
 		n->wlan_tx_streams = p->wlan_tx_streams;
 	if (p->wlan_rx_streams)
 		n->wlan_rx_streams = p->wlan_rx_streams;
+	/* the AP announces it, all PPDUs of the BSS carry it */
+	if (p->wlan_bss_color)
+		n->wlan_bss_color = p->wlan_bss_color;
+	else if (p->phy_bss_color)
+		n->wlan_bss_color = p->phy_bss_color;
 
 	if ((p->wlan_type == WLAN_FRAME_BEACON) ||
 	    (p->wlan_type == WLAN_FRAME_PROBE_RESP)) {
@@ -55,6 +188,7 @@ static void copy_nodeinfo(struct uwifi_node* n, struct uwifi_packet* p)
 		n->wlan_rsn = p->wlan_rsn;
 		// Channel is only really known for Beacon and Probe response
 		n->wlan_channel = p->wlan_channel;
+		n->wlan_6g_channel = p->wlan_6g_channel;
 	} else if ((n->wlan_mode & WLAN_MODE_STA) && n->ap_node) {
 		// for STA we can use the channel from the AP
 		n->wlan_channel = n->ap_node->wlan_channel;
@@ -97,19 +231,26 @@ static void copy_nodeinfo(struct uwifi_node* n, struct uwifi_packet* p)
 	if (p->wlan_chan_width > n->wlan_chan_width)
 		n->wlan_chan_width = p->wlan_chan_width;
 
-	/* guess IEEE802.11 Standard from channel width, packet type and rate */
+	/* guess IEEE802.11 Standard from channel width, packet type, rate,
+	 * PHY header and HE/EHT IEs */
 	enum uwifi_80211_std chstd = wlan_80211std_from_chan(p->wlan_chan_width, p->wlan_channel);
 	enum uwifi_80211_std rstd = wlan_80211std_from_rate(p->phy_rate_idx, p->wlan_channel);
 	enum uwifi_80211_std ptstd = wlan_80211std_from_type(p->wlan_type);
+	enum uwifi_80211_std phystd = wlan_80211std_from_phy(p->phy_flags);
 	enum uwifi_80211_std mstd = MAX(chstd, rstd);
 	mstd = MAX(mstd, ptstd);
+	mstd = MAX(mstd, phystd);
+	if (p->wlan_eht)
+		mstd = MAX(mstd, IEEE80211_BE);
+	else if (p->wlan_he)
+		mstd = MAX(mstd, IEEE80211_AX);
 	n->wlan_std = MAX(n->wlan_std, mstd);
 
 	/* set packet retries from node sum */
 	p->wlan_retries = n->wlan_retries_last;
 }
 
-struct uwifi_node* uwifi_node_update(struct uwifi_packet* p, struct cc_list_head* nodes)
+struct uwifi_node* uwifi_node_update(struct uwifi_packet* p, struct uwifi_nodes* nodes)
 {
 	struct uwifi_node* n;
 
@@ -122,25 +263,18 @@ struct uwifi_node* uwifi_node_update(struct uwifi_packet* p, struct cc_list_head
 		return NULL;
 
 	/* find node by wlan source address */
-	cc_list_for_each(nodes, n, list) {
-		if (memcmp(p->wlan_ta, n->wlan_src, WLAN_MAC_LEN) == 0) {
-			LOG_DBG("NODE found %p " MAC_FMT, n, MAC_PAR(p->wlan_ta));
-			break;
-		}
-	}
+	n = uwifi_node_find(nodes, p->wlan_ta);
 
 	/* not found */
-	if (&n->list == &nodes->n) {
-		n = (struct uwifi_node*)malloc(sizeof(struct uwifi_node));
-		memset(n, 0, sizeof(struct uwifi_node));
-		ewma_init(&n->phy_sig_avg, 1024, 8);
-		      cc_list_head_init(&n->on_channels);
-		      cc_list_head_init(&n->ap_nodes);
-		cc_list_add_tail(nodes, &n->list);
+	if (n == NULL) {
+		n = node_new(nodes, p->wlan_ta);
+		if (n == NULL)
+			return NULL;
 		LOG_DBG("NODE adding %p " MAC_FMT, n, MAC_PAR(p->wlan_ta));
 	}
 
-	copy_nodeinfo(n, p);
+	copy_nodeinfo(nodes, n, p);
+	node_lru_update(nodes, n);
 	return n;
 }
 
@@ -151,7 +285,7 @@ static void copy_rx_nodeinfo(struct uwifi_node* n, struct uwifi_packet* p)
 	if (MAC_NOT_EMPTY(p->wlan_bssid))
 		memcpy(n->wlan_bssid, p->wlan_bssid, WLAN_MAC_LEN);
 
-	n->last_seen = plat_time_usec();
+	n->last_seen = packet_time_ns(p);
 	n->rx_pkt_count++;
 	n->pkt_types |= p->pkt_types;
 
@@ -185,7 +319,7 @@ static void copy_rx_nodeinfo(struct uwifi_node* n, struct uwifi_packet* p)
 		n->wlan_wep = p->wlan_wep;
 }
 
-struct uwifi_node* uwifi_node_update_receiver(struct uwifi_packet* p, struct cc_list_head* nodes)
+struct uwifi_node* uwifi_node_update_receiver(struct uwifi_packet* p, struct uwifi_nodes* nodes)
 {
 	struct uwifi_node* n;
 
@@ -196,30 +330,23 @@ struct uwifi_node* uwifi_node_update_receiver(struct uwifi_packet* p, struct cc_
 		return NULL;
 
 	/* find node by wlan source address */
-	cc_list_for_each(nodes, n, list) {
-		if (memcmp(p->wlan_ra, n->wlan_src, WLAN_MAC_LEN) == 0) {
-			LOG_DBG("RX NODE found %p " MAC_FMT, n, MAC_PAR(p->wlan_ra));
-			break;
-		}
-	}
+	n = uwifi_node_find(nodes, p->wlan_ra);
 
 	/* not found */
-	if (&n->list == &nodes->n) {
-		n = (struct uwifi_node*)malloc(sizeof(struct uwifi_node));
-		memset(n, 0, sizeof(struct uwifi_node));
-		ewma_init(&n->phy_sig_avg, 1024, 8);
-		      cc_list_head_init(&n->on_channels);
-		      cc_list_head_init(&n->ap_nodes);
-		cc_list_add_tail(nodes, &n->list);
+	if (n == NULL) {
+		n = node_new(nodes, p->wlan_ra);
+		if (n == NULL)
+			return NULL;
 		LOG_DBG("RX NODE adding %p " MAC_FMT, n, MAC_PAR(p->wlan_ra));
 		n->rx_only = true;
 	}
 
 	copy_rx_nodeinfo(n, p);
+	node_lru_update(nodes, n);
 	return n;
 }
 
-void uwifi_nodes_find_ap(struct uwifi_node* n, struct cc_list_head* nodes)
+void uwifi_nodes_find_ap(struct uwifi_node* n, struct uwifi_nodes* nodes)
 {
 	struct uwifi_node* ap;
 
@@ -235,69 +362,267 @@ void uwifi_nodes_find_ap(struct uwifi_node* n, struct cc_list_head* nodes)
 			n->ap_node = NULL;
 		}
 		/* find AP node and add to his list of stations */
-		cc_list_for_each(nodes, ap, list) {
-			if (memcmp(n->wlan_bssid, ap->wlan_src, WLAN_MAC_LEN) == 0) {
-				LOG_DBG("AP node found %p " MAC_FMT,
-					ap, MAC_PAR(n->wlan_bssid));
-				cc_list_add_tail(&ap->ap_nodes, &n->ap_list);
-				n->ap_node = ap;
-				break;
-			}
+		ap = uwifi_node_find(nodes, n->wlan_bssid);
+		if (ap != NULL) {
+			LOG_DBG("AP node found %p " MAC_FMT,
+				ap, MAC_PAR(n->wlan_bssid));
+			cc_list_add_tail(&ap->ap_nodes, &n->ap_list);
+			n->ap_node = ap;
 		}
 		/* TODO: what if AP is unknown? */
 	}
 }
 
-void uwifi_nodes_timeout(struct cc_list_head* nodes, unsigned int timeout_sec,
-			 uint32_t* last_nodetimeout)
+/*
+ * Remove nodes not seen for timeout_sec. @now is the current time on the clock
+ * of the packet timestamps, e.g. the file time when replaying a capture, or 0
+ * to read the clock.
+ */
+void uwifi_nodes_timeout(struct uwifi_nodes* nodes, unsigned int timeout_sec,
+			 uint64_t* last_nodetimeout, uint64_t now)
 {
-	struct uwifi_node *n, *m, *n2, *m2;
+	struct uwifi_node *n, *n2, *m2;
 //	struct chan_node *cn, *cn2;
-	uint32_t the_time = plat_time_usec();
+	uint64_t the_time = now ? now : plat_time_ns_coarse();
+	int64_t timeout_ns = (int64_t)timeout_sec * 1000000000;
 
-	if ((the_time - *last_nodetimeout) < timeout_sec * 1000000)
+	if ((int64_t)(the_time - *last_nodetimeout) < timeout_ns)
 		return;
 	LOG_DBG("NODE timeout %d", timeout_sec);
 
-	cc_list_for_each_safe(nodes, n, m, list) {
-		if (the_time - n->last_seen > timeout_sec * 1000000) {
-			LOG_DBG("NODE timeout %p " MAC_FMT, n,
-				MAC_PAR(n->wlan_src));
-			cc_list_del_from(nodes, &n->list);
-			if (n->ap_node) {
-				cc_list_del_from(&n->ap_node->ap_nodes, &n->ap_list);
-				n->ap_node = NULL;
-			}
-			if (n->essid != NULL)
-				uwifi_essids_remove_node(n);
-//			list_for_each_safe(&n->on_channels, cn, cn2, node_list) {
-//				list_del(&cn->node_list);
-//				list_del(&cn->chan_list);
-//				cn->chan->num_nodes--;
-//				free(cn);
-//			}
-			/* clear AP list */
-			cc_list_for_each_safe(&n->ap_nodes, n2, m2, ap_list) {
-				cc_list_del_from(&n->ap_nodes, &n2->ap_list);
-				n2->ap_node = NULL;
-			}
-			free(n);
+	/* the LRU list is ordered by last_seen, so we only need to look at
+	 * the nodes which actually expire */
+	while (!cc_list_empty(&nodes->lru)) {
+		n = cc_list_top(&nodes->lru, struct uwifi_node, lru_list);
+		/* signed, packet timestamps may be slightly ahead of the_time */
+		if ((int64_t)(the_time - n->last_seen) <= timeout_ns)
+			break;
+
+		LOG_DBG("NODE timeout %p " MAC_FMT, n, MAC_PAR(n->wlan_src));
+		cc_list_del(&n->lru_list);
+		cc_list_del_from(&nodes->list, &n->list);
+		mac_hash_del(&nodes->idx, mac_to_u64(n->wlan_src));
+		if (n->ap_node) {
+			cc_list_del_from(&n->ap_node->ap_nodes, &n->ap_list);
+			n->ap_node = NULL;
+		}
+		if (n->essid != NULL)
+			uwifi_essids_remove_node(n);
+//		list_for_each_safe(&n->on_channels, cn, cn2, node_list) {
+//			list_del(&cn->node_list);
+//			list_del(&cn->chan_list);
+//			cn->chan->num_nodes--;
+//			free(cn);
+//		}
+		/* clear AP list */
+		cc_list_for_each_safe(&n->ap_nodes, n2, m2, ap_list) {
+			cc_list_del_from(&n->ap_nodes, &n2->ap_list);
+			n2->ap_node = NULL;
 		}
+		node_free(nodes, n);
+		UWIFI_STAT_INC(node_evictions);
 	}
 	*last_nodetimeout = the_time;
 }
 
-void uwifi_nodes_free(struct cc_list_head* nodes)
+/* combine counters of two views of the same node, latest info wins */
+static void merge_nodeinfo(struct uwifi_node* n, const struct uwifi_node* o)
+{
+	n->pkt_types |= o->pkt_types;
+	n->pkt_count += o->pkt_count;
+	n->rx_pkt_count += o->rx_pkt_count;
+	n->rx_only = n->rx_only && o->rx_only;
+	n->wlan_mode |= o->wlan_mode;
+	n->phy_sig_sum += o->phy_sig_sum;
+	n->phy_sig_count += o->phy_sig_count;
+	n->wlan_retries_all += o->wlan_retries_all;
+	n->wlan_chan_width = MAX(n->wlan_chan_width, o->wlan_chan_width);
+	n->wlan_std = MAX(n->wlan_std, o->wlan_std);
+	n->wlan_tx_streams = MAX(n->wlan_tx_streams, o->wlan_tx_streams);
+	n->wlan_rx_streams = MAX(n->wlan_rx_streams, o->wlan_rx_streams);
+	n->wlan_ht40plus |= o->wlan_ht40plus;
+
+	if (o->phy_sig_max > n->phy_sig_max || n->phy_sig_max == 0)
+		n->phy_sig_max = o->phy_sig_max;
+
+	if ((int64_t)(o->last_seen - n->last_seen) <= 0)
+		return;
+
+	n->last_seen = o->last_seen;
+	n->phy_rate_last = o->phy_rate_last;
+	n->phy_sig_last = o->phy_sig_last;
+	n->phy_sig_avg = o->phy_sig_avg;
+	if (MAC_NOT_EMPTY(o->wlan_bssid))
+		memcpy(n->wlan_bssid, o->wlan_bssid, WLAN_MAC_LEN);
+	if (o->wlan_channel)
+		n->wlan_channel = o->wlan_channel;
+	if (o->wlan_6g_channel)
+		n->wlan_6g_channel = o->wlan_6g_channel;
+	if (o->wlan_tsf)
+		n->wlan_tsf = o->wlan_tsf;
+	if (o->wlan_bintval)
+		n->wlan_bintval = o->wlan_bintval;
+	if (o->wlan_bss_color)
+		n->wlan_bss_color = o->wlan_bss_color;
+	n->wlan_retries_last = o->wlan_retries_last;
+	n->wlan_seqno = o->wlan_seqno;
+	n->wlan_wep = o->wlan_wep;
+	n->wlan_wpa = o->wlan_wpa;
+	n->wlan_rsn = o->wlan_rsn;
+}
+
+static void merge_node_ext(struct uwifi_nodes* nodes, struct uwifi_node* n,
+			   const struct uwifi_node* o)
+{
+	if (o->ext == NULL)
+		return;
+
+	if (n->ext == NULL) {
+		n->ext = node_ext_alloc(nodes);
+		if (n->ext == NULL)
+			return;
+		memcpy(n->ext, o->ext, sizeof(struct uwifi_node_ext));
+		return;
+	}
+
+	n->ext->bat_gw |= o->ext->bat_gw;
+	n->ext->olsr_count += o->ext->olsr_count;
+	if (o->ext->ip_src)
+		n->ext->ip_src = o->ext->ip_src;
+	if (o->ext->olsr_neigh)
+		n->ext->olsr_neigh = o->ext->olsr_neigh;
+	if (o->ext->olsr_tc)
+		n->ext->olsr_tc = o->ext->olsr_tc;
+}
+
+/*
+ * Merge node src (from another node list) into the list nodes and return the
+ * resulting node. A copy of src is added if the MAC was not known yet. This is
+ * used to combine per-thread node lists. AP and ESSID relations are not copied,
+ * use uwifi_nodes_find_ap() and uwifi_essids_add_node() for that.
+ *
+ * The node is appended to the LRU list, which is not ordered any more until
+ * uwifi_nodes_sort_lru() is called after merging all nodes. Sorting each one
+ * into place would walk the list for every node.
+ */
+struct uwifi_node* uwifi_node_merge(const struct uwifi_node* src,
+				    struct uwifi_nodes* nodes)
+{
+	struct uwifi_node* n;
+
+	n = uwifi_node_find(nodes, src->wlan_src);
+	if (n != NULL) {
+		merge_nodeinfo(n, src);
+		merge_node_ext(nodes, n, src);
+		cc_list_del(&n->lru_list);
+		cc_list_add_tail(&nodes->lru, &n->lru_list);
+		return n;
+	}
+
+	n = node_alloc(nodes);
+	if (n == NULL)
+		return NULL;
+	memcpy(n, src, sizeof(struct uwifi_node));
+
+	n->ext = NULL;
+	merge_node_ext(nodes, n, src);
+
+	if (!mac_hash_put(&nodes->idx, mac_to_u64(n->wlan_src), n)) {
+		node_free(nodes, n);
+		return NULL;
+	}
+
+	n->ap_node = NULL;
+	n->essid = NULL;
+	n->num_on_channels = 0;
+	cc_list_head_init(&n->on_channels);
+	cc_list_head_init(&n->ap_nodes);
+	cc_list_add_tail(&nodes->list, &n->list);
+	cc_list_add_tail(&nodes->lru, &n->lru_list);
+	UWIFI_STAT_INC(node_inserts);
+	LOG_DBG("NODE merged %p " MAC_FMT, n, MAC_PAR(n->wlan_src));
+	return n;
+}
+
+/* merge two NULL terminated runs linked by next, a before b when equal */
+static struct cc_list_node* lru_merge(struct cc_list_node* a, struct cc_list_node* b)
+{
+	struct cc_list_node head;
+	struct cc_list_node* t = &head;
+
+	while (a != NULL && b != NULL) {
+		if ((int64_t)(cc_list_entry(b, struct uwifi_node, lru_list)->last_seen -
+			      cc_list_entry(a, struct uwifi_node, lru_list)->last_seen) < 0) {
+			t->next = b;
+			b = b->next;
+		} else {
+			t->next = a;
+			a = a->next;
+		}
+		t = t->next;
+	}
+	t->next = a != NULL ? a : b;
+	return head.next;
+}
+
+/*
+ * Bottom-up merge sort of the LRU list by last_seen: runs[i] holds a sorted
+ * run of 2^i nodes, which all come before the nodes in runs[i - 1]
+ */
+void uwifi_nodes_sort_lru(struct uwifi_nodes* nodes)
+{
+	struct cc_list_node* runs[64] = { NULL };
+	struct cc_list_node *l, *n, *prev;
+	int i, max = 0;
+
+	if (cc_list_empty(&nodes->lru))
+		return;
+
+	nodes->lru.n.prev->next = NULL;
+	l = nodes->lru.n.next;
+	while (l != NULL) {
+		n = l;
+		l = l->next;
+		n->next = NULL;
+		for (i = 0; runs[i] != NULL; i++) {
+			n = lru_merge(runs[i], n);
+			runs[i] = NULL;
+		}
+		runs[i] = n;
+		if (i > max)
+			max = i;
+	}
+
+	n = NULL;
+	for (i = 0; i <= max; i++) {
+		if (runs[i] != NULL)
+			n = n != NULL ? lru_merge(runs[i], n) : runs[i];
+	}
+
+	/* restore the prev pointers */
+	prev = &nodes->lru.n;
+	for (; n != NULL; n = n->next) {
+		prev->next = n;
+		n->prev = prev;
+		prev = n;
+	}
+	prev->next = &nodes->lru.n;
+	nodes->lru.n.prev = prev;
+}
+
+void uwifi_nodes_free(struct uwifi_nodes* nodes)
 {
 	struct uwifi_node *ni, *mi;
 
 	/* protect against uninitialized lists */
-	if (nodes->n.next == NULL)
+	if (nodes->list.n.next == NULL)
 		return;
 
-	cc_list_for_each_safe(nodes, ni, mi, list) {
+	cc_list_for_each_safe(&nodes->list, ni, mi, list) {
 		LOG_DBG("NODE free %p " MAC_FMT, ni, MAC_PAR(ni->wlan_src));
-		cc_list_del_from(nodes, &ni->list);
-		free(ni);
+		cc_list_del_from(&nodes->list, &ni->list);
+		node_free(nodes, ni);
 	}
+	mac_hash_free(&nodes->idx);
+	cc_list_head_init(&nodes->lru);
 }
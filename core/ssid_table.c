@@ -0,0 +1,164 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+#include "wlan80211.h"
+#include "wlan_parser.h"
+#include "ssid_table.h"
+#include "log.h"
+
+#define SSID_TABLE_MIN_SIZE	32
+
+uint32_t uwifi_ssid_hash(const char* ssid, unsigned int len)
+{
+	uint32_t h = 2166136261u;
+	unsigned int i;
+
+	h = (h ^ len) * 16777619;
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char)ssid[i]) * 16777619;
+	return h;
+}
+
+void uwifi_ssid_table_init(struct uwifi_ssid_table* t)
+{
+	memset(t, 0, sizeof(*t));
+}
+
+void uwifi_ssid_table_free(struct uwifi_ssid_table* t)
+{
+	unsigned int max = t->max;
+
+	free(t->entries);
+	free(t->idx);
+	mac_hash_free(&t->bssid_cache);
+	memset(t, 0, sizeof(*t));
+	t->max = max;
+}
+
+static inline bool entry_equal(const struct uwifi_ssid_entry* e, const char* ssid,
+			       unsigned int len)
+{
+	return e->len == len && memcmp(e->ssid, ssid, len) == 0;
+}
+
+static bool idx_resize(struct uwifi_ssid_table* t, unsigned int size)
+{
+	uint32_t* idx = calloc(size, sizeof(uint32_t));
+	unsigned int i, j;
+
+	if (idx == NULL)
+		return false;
+
+	for (i = 0; i < t->num; i++) {
+		for (j = t->entries[i].hash & (size - 1); idx[j] != 0; j = (j + 1) & (size - 1))
+			;
+		idx[j] = i + 1;
+	}
+
+	free(t->idx);
+	t->idx = idx;
+	t->idx_size = size;
+	return true;
+}
+
+static uint32_t table_add(struct uwifi_ssid_table* t, const char* ssid,
+			  unsigned int len, uint32_t hash, unsigned int slot)
+{
+	struct uwifi_ssid_entry* e;
+
+	if (t->max > 0 && t->num >= t->max)
+		return 0;
+
+	if (t->num == t->size) {
+		unsigned int size = t->size ? t->size * 2 : SSID_TABLE_MIN_SIZE;
+		e = realloc(t->entries, size * sizeof(struct uwifi_ssid_entry));
+		if (e == NULL)
+			return 0;
+		t->entries = e;
+		t->size = size;
+	}
+
+	e = &t->entries[t->num];
+	e->hash = hash;
+	e->len = len;
+	memcpy(e->ssid, ssid, len);
+	e->ssid[len] = '\0';
+	t->idx[slot] = ++t->num;
+	LOG_DBG("SSID intern '%s' id %u", e->ssid, t->num);
+	return t->num;
+}
+
+uint32_t uwifi_ssid_intern(struct uwifi_ssid_table* t, const char* ssid,
+			   unsigned int len)
+{
+	uint32_t hash;
+	unsigned int i;
+
+	if (len > WLAN_MAX_SSID_LEN - 1)
+		len = WLAN_MAX_SSID_LEN - 1;
+
+	/* keep load factor below 1/2 */
+	if ((t->num + 1) * 2 > t->idx_size &&
+	    !idx_resize(t, t->idx_size ? t->idx_size * 2 : SSID_TABLE_MIN_SIZE * 2))
+		return 0;
+
+	hash = uwifi_ssid_hash(ssid, len);
+	for (i = hash & (t->idx_size - 1); t->idx[i] != 0; i = (i + 1) & (t->idx_size - 1)) {
+		struct uwifi_ssid_entry* e = &t->entries[t->idx[i] - 1];
+		if (e->hash == hash && entry_equal(e, ssid, len))
+			return t->idx[i];
+	}
+
+	return table_add(t, ssid, len, hash, i);
+}
+
+uint32_t uwifi_ssid_intern_bssid(struct uwifi_ssid_table* t, const unsigned char* bssid,
+				 const char* ssid, unsigned int len)
+{
+	uint64_t key = mac_to_u64(bssid);
+	uint32_t id = (uintptr_t)mac_hash_get(&t->bssid_cache, key);
+
+	if (len > WLAN_MAX_SSID_LEN - 1)
+		len = WLAN_MAX_SSID_LEN - 1;
+
+	if (id != 0 && entry_equal(&t->entries[id - 1], ssid, len))
+		return id;
+
+	id = uwifi_ssid_intern(t, ssid, len);
+	if (id != 0)
+		mac_hash_put(&t->bssid_cache, key, (void*)(uintptr_t)id);
+	return id;
+}
+
+uint32_t uwifi_ssid_intern_packet(struct uwifi_ssid_table* t, struct uwifi_packet* p)
+{
+	/* only beacons and probe responses, probe requests from random MACs
+	 * would fill the BSSID cache */
+	if (p->wlan_essid_len == 0 ||
+	    (p->wlan_type != WLAN_FRAME_BEACON && p->wlan_type != WLAN_FRAME_PROBE_RESP))
+		return 0;
+
+	p->wlan_ssid_id = uwifi_ssid_intern_bssid(t, p->wlan_ta, p->wlan_essid,
+						   p->wlan_essid_len);
+	return p->wlan_ssid_id;
+}
+
+const char* uwifi_ssid_get(const struct uwifi_ssid_table* t, uint32_t id,
+			   unsigned int* len)
+{
+	if (id == 0 || id > t->num)
+		return NULL;
+	if (len != NULL)
+		*len = t->entries[id - 1].len;
+	return t->entries[id - 1].ssid;
+}
@@ -0,0 +1,115 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#include <string.h>
+
+#include "stats.h"
+
+#if UWIFI_STATS
+
+#include <pthread.h>
+
+#define STATS_NUM	(sizeof(struct uwifi_stats) / sizeof(uint64_t))
+
+__thread struct uwifi_stats_block uwifi_stats_local;
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;
+static struct uwifi_stats_block* stats_threads;
+static struct uwifi_stats stats_exited;	/* sum of exited threads */
+
+/* all fields are uint64_t counters, except the maximum */
+static void stats_add(struct uwifi_stats* dst, const struct uwifi_stats* src)
+{
+	const uint64_t* s = (const uint64_t*)src;
+	uint64_t* d = (uint64_t*)dst;
+	uint64_t max = dst->hash_probe_max;
+	uint64_t v;
+	unsigned int i;
+
+	for (i = 0; i < STATS_NUM; i++)
+		d[i] += __atomic_load_n(&s[i], __ATOMIC_RELAXED);
+
+	v = __atomic_load_n(&src->hash_probe_max, __ATOMIC_RELAXED);
+	dst->hash_probe_max = v > max ? v : max;
+}
+
+/* thread exit: keep the counts and unlink the thread local block */
+static void stats_thread_exit(void* arg)
+{
+	struct uwifi_stats_block* b = arg;
+	struct uwifi_stats_block** pb;
+
+	pthread_mutex_lock(&stats_lock);
+	for (pb = &stats_threads; *pb != NULL; pb = &(*pb)->next) {
+		if (*pb == b) {
+			*pb = b->next;
+			break;
+		}
+	}
+	stats_add(&stats_exited, &b->s);
+	pthread_mutex_unlock(&stats_lock);
+}
+
+static void stats_init(void)
+{
+	pthread_key_create(&stats_key, stats_thread_exit);
+}
+
+void uwifi_stats_register(void)
+{
+	struct uwifi_stats_block* b = &uwifi_stats_local;
+
+	pthread_once(&stats_once, stats_init);
+
+	pthread_mutex_lock(&stats_lock);
+	b->registered = true;
+	b->next = stats_threads;
+	stats_threads = b;
+	pthread_mutex_unlock(&stats_lock);
+
+	pthread_setspecific(stats_key, b);
+}
+
+bool uwifi_stats_snapshot(struct uwifi_stats* s)
+{
+	struct uwifi_stats_block* b;
+
+	memset(s, 0, sizeof(*s));
+
+	pthread_mutex_lock(&stats_lock);
+	stats_add(s, &stats_exited);
+	for (b = stats_threads; b != NULL; b = b->next)
+		stats_add(s, &b->s);
+	pthread_mutex_unlock(&stats_lock);
+	return true;
+}
+
+bool uwifi_stats_snapshot_thread(struct uwifi_stats* s)
+{
+	memcpy(s, &uwifi_stats_local.s, sizeof(*s));
+	return true;
+}
+
+#else
+
+bool uwifi_stats_snapshot(struct uwifi_stats* s)
+{
+	memset(s, 0, sizeof(*s));
+	return false;
+}
+
+bool uwifi_stats_snapshot_thread(struct uwifi_stats* s)
+{
+	memset(s, 0, sizeof(*s));
+	return false;
+}
+
+#endif
@@ -0,0 +1,358 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#include <string.h>
+
+#include "platform.h"
+#include "wlan80211.h"
+#include "wlan_parser.h"
+#include "wlan_ie.h"
+
+static inline uint16_t get_le16(const unsigned char* b)
+{
+	return b[0] | b[1] << 8;
+}
+
+static inline uint32_t get_le24(const unsigned char* b)
+{
+	return b[0] | b[1] << 8 | (uint32_t)b[2] << 16;
+}
+
+static inline uint32_t get_le32(const unsigned char* b)
+{
+	return get_le24(b) | (uint32_t)b[3] << 24;
+}
+
+static inline uint32_t get_suite(const unsigned char* b)
+{
+	return WLAN_SUITE((uint32_t)b[0] << 16 | b[1] << 8 | b[2], b[3]);
+}
+
+static inline const struct information_element* ie_at(const struct uwifi_packet* p,
+						      const struct uwifi_ie_ref* ref)
+{
+	return (const struct information_element*)(p->wlan_ies + ref->off);
+}
+
+const struct information_element* uwifi_ie_get(const struct uwifi_packet* p, uint8_t id)
+{
+	int i;
+
+	for (i = 0; i < p->wlan_ie_num; i++) {
+		if (p->wlan_ie_idx[i].id == id)
+			return ie_at(p, &p->wlan_ie_idx[i]);
+	}
+	return NULL;
+}
+
+const struct information_element* uwifi_ie_get_ext(const struct uwifi_packet* p, uint8_t ext_id)
+{
+	int i;
+
+	for (i = 0; i < p->wlan_ie_num; i++) {
+		if (p->wlan_ie_idx[i].id == WLAN_IE_ID_EXT &&
+		    p->wlan_ie_idx[i].ext_id == ext_id && p->wlan_ie_idx[i].len > 0)
+			return ie_at(p, &p->wlan_ie_idx[i]);
+	}
+	return NULL;
+}
+
+const struct information_element* uwifi_ie_get_vendor(const struct uwifi_packet* p,
+						       uint32_t oui, uint8_t type)
+{
+	const struct information_element* ie;
+	int i;
+
+	for (i = 0; i < p->wlan_ie_num; i++) {
+		if (p->wlan_ie_idx[i].id != WLAN_IE_ID_VENDOR || p->wlan_ie_idx[i].len < 4)
+			continue;
+		ie = ie_at(p, &p->wlan_ie_idx[i]);
+		if (get_suite(ie->var) == WLAN_SUITE(oui, type))
+			return ie;
+	}
+	return NULL;
+}
+
+/* read a suite list, return consumed length or -1 if it is truncated */
+static int rsn_suites(const unsigned char* b, int len, uint8_t* num, uint32_t* suites)
+{
+	int cnt, i;
+
+	if (len < 2)
+		return -1;
+	cnt = get_le16(b);
+	if (len < 2 + cnt * 4)
+		return -1;
+	*num = cnt > 255 ? 255 : cnt;
+	for (i = 0; i < cnt && i < UWIFI_IE_RSN_MAX_SUITES; i++)
+		suites[i] = get_suite(b + 2 + i * 4);
+	return 2 + cnt * 4;
+}
+
+bool uwifi_ie_rsn(const struct uwifi_packet* p, struct uwifi_ie_rsn* rsn)
+{
+	const struct information_element* ie = uwifi_ie_get(p, WLAN_IE_ID_RSN);
+	const unsigned char* b;
+	int len, ret;
+
+	memset(rsn, 0, sizeof(*rsn));
+	if (ie == NULL || ie->len < 2)
+		return false;
+
+	b = ie->var;
+	len = ie->len;
+	rsn->version = get_le16(b);
+	/* CCMP is the default when the group cipher is missing */
+	rsn->group_cipher = WLAN_CIPHER_CCMP;
+	b += 2; len -= 2;
+
+	if (len < 4)
+		return true;
+	rsn->group_cipher = get_suite(b);
+	b += 4; len -= 4;
+
+	ret = rsn_suites(b, len, &rsn->num_pairwise, rsn->pairwise);
+	if (ret < 0)
+		return true;
+	b += ret; len -= ret;
+
+	ret = rsn_suites(b, len, &rsn->num_akm, rsn->akm);
+	if (ret < 0)
+		return true;
+	b += ret; len -= ret;
+
+	if (len < 2)
+		return true;
+	rsn->capab = get_le16(b);
+	b += 2; len -= 2;
+
+	/* skip PMKIDs */
+	if (len < 2 || len < 2 + get_le16(b) * 16)
+		return true;
+	len -= 2 + get_le16(b) * 16;
+	b += 2 + get_le16(b) * 16;
+
+	if (len >= 4)
+		rsn->group_mgmt_cipher = get_suite(b);
+	return true;
+}
+
+bool uwifi_ie_country(const struct uwifi_packet* p, struct uwifi_ie_country* c)
+{
+	const struct information_element* ie = uwifi_ie_get(p, WLAN_IE_ID_COUNTRY);
+	int i;
+
+	memset(c, 0, sizeof(*c));
+	if (ie == NULL || ie->len < 3)
+		return false;
+
+	c->cc[0] = ie->var[0];
+	c->cc[1] = ie->var[1];
+	c->env = ie->var[2];
+
+	for (i = 3; i + 3 <= ie->len && c->num < UWIFI_IE_COUNTRY_MAX; i += 3) {
+		/* operating extension triplets start with 201 or more */
+		if (ie->var[i] >= 201)
+			continue;
+		c->sub[c->num].first_chan = ie->var[i];
+		c->sub[c->num].num_chans = ie->var[i + 1];
+		c->sub[c->num].max_power = ie->var[i + 2];
+		c->num++;
+	}
+	return true;
+}
+
+bool uwifi_ie_bss_load(const struct uwifi_packet* p, struct uwifi_ie_bss_load* bl)
+{
+	const struct information_element* ie = uwifi_ie_get(p, WLAN_IE_ID_BSS_LOAD);
+
+	memset(bl, 0, sizeof(*bl));
+	if (ie == NULL || ie->len < 5)
+		return false;
+
+	bl->sta_count = get_le16(ie->var);
+	bl->chan_util = ie->var[2];
+	bl->adm_capacity = get_le16(ie->var + 3);
+	return true;
+}
+
+bool uwifi_ie_ext_capab(const struct uwifi_packet* p, unsigned int bit)
+{
+	const struct information_element* ie = uwifi_ie_get(p, WLAN_IE_ID_EXT_CAPAB);
+
+	if (ie == NULL || bit / 8 >= ie->len)
+		return false;
+	return ie->var[bit / 8] & BIT(bit % 8);
+}
+
+bool uwifi_ie_he_capab(const struct uwifi_packet* p, struct uwifi_ie_he_capab* he)
+{
+	const struct information_element* ie = uwifi_ie_get_ext(p, WLAN_IE_EXT_HE_CAPAB);
+	const unsigned char* b;
+	int i, num = 1;
+
+	memset(he, 0, sizeof(*he));
+	/* extension ID, MAC and PHY capabilities and the <= 80MHz MCS map */
+	if (ie == NULL || ie->len < 1 + 6 + 11 + 4)
+		return false;
+
+	b = ie->var + 1;
+	memcpy(he->mac_capab, b, 6);
+	memcpy(he->phy_capab, b + 6, 11);
+
+	/* channel width set: 160MHz and 80+80MHz add one MCS map each */
+	if (he->phy_capab[0] & WLAN_IE_HE_PHY_CAPAB_160_5G)
+		num++;
+	if (he->phy_capab[0] & WLAN_IE_HE_PHY_CAPAB_8080_5G)
+		num++;
+	if (ie->len < 1 + 6 + 11 + num * 4)
+		num = (ie->len - 1 - 6 - 11) / 4;
+
+	b += 6 + 11;
+	for (i = 0; i < num; i++) {
+		he->rx_mcs[i] = get_le16(b + i * 4);
+		he->tx_mcs[i] = get_le16(b + i * 4 + 2);
+	}
+	he->num_mcs = num;
+	return true;
+}
+
+bool uwifi_ie_he_oper(const struct uwifi_packet* p, struct uwifi_ie_he_oper* he)
+{
+	const struct information_element* ie = uwifi_ie_get_ext(p, WLAN_IE_EXT_HE_OPER);
+	const unsigned char* b;
+	int len;
+
+	memset(he, 0, sizeof(*he));
+	if (ie == NULL || ie->len < 1 + 3 + 1 + 2)
+		return false;
+
+	b = ie->var + 1;
+	len = ie->len - 1;
+	he->params = get_le24(b);
+	he->bss_color = b[3] & 0x3f;
+	he->bss_color_disabled = b[3] & 0x80;
+	he->basic_mcs = get_le16(b + 4);
+	b += 6; len -= 6;
+
+	if (he->params & WLAN_HE_OPER_VHT_INFO) {
+		b += 3; len -= 3;
+	}
+	if (he->params & WLAN_HE_OPER_COHOSTED_BSS) {
+		b += 1; len -= 1;
+	}
+	if (he->params & WLAN_HE_OPER_6GHZ_INFO && len >= 5) {
+		he->has_6ghz = true;
+		he->primary_chan_6ghz = b[0];
+		he->width_6ghz = b[1] & 0x03;
+		he->center_seg0_6ghz = b[2];
+		he->center_seg1_6ghz = b[3];
+	}
+	return true;
+}
+
+bool uwifi_ie_eht_capab(const struct uwifi_packet* p, struct uwifi_ie_eht_capab* eht)
+{
+	const struct information_element* ie = uwifi_ie_get_ext(p, WLAN_IE_EXT_EHT_CAPAB);
+
+	memset(eht, 0, sizeof(*eht));
+	if (ie == NULL || ie->len < 1 + 2 + 9)
+		return false;
+
+	memcpy(eht->mac_capab, ie->var + 1, 2);
+	memcpy(eht->phy_capab, ie->var + 3, 9);
+	return true;
+}
+
+bool uwifi_ie_eht_oper(const struct uwifi_packet* p, struct uwifi_ie_eht_oper* eht)
+{
+	const struct information_element* ie = uwifi_ie_get_ext(p, WLAN_IE_EXT_EHT_OPER);
+	const unsigned char* b;
+	int len;
+
+	memset(eht, 0, sizeof(*eht));
+	if (ie == NULL || ie->len < 1 + 1 + 4)
+		return false;
+
+	b = ie->var + 1;
+	len = ie->len - 1;
+	eht->params = b[0];
+	eht->basic_mcs = get_le32(b + 1);
+	b += 5; len -= 5;
+
+	if (eht->params & WLAN_EHT_OPER_INFO && len >= 3) {
+		eht->has_info = true;
+		eht->width = b[0] & 0x07;
+		eht->ccfs0 = b[1];
+		eht->ccfs1 = b[2];
+		b += 3; len -= 3;
+		if (eht->params & WLAN_EHT_OPER_DISABLED_SUBCHAN && len >= 2)
+			eht->disabled_subchan = get_le16(b);
+	}
+	return true;
+}
+
+/* fields of a TBTT information set depend on its length */
+static void rnr_tbtt_info(struct uwifi_ie_rnr_ap* ap, const unsigned char* b, int len)
+{
+	ap->tbtt_offset = b[0];
+
+	if (len == 2) {
+		ap->bss_params = b[1];
+	} else if (len == 5 || len == 6) {
+		ap->has_short_ssid = true;
+		ap->short_ssid = get_le32(b + 1);
+		if (len == 6)
+			ap->bss_params = b[5];
+	} else if (len >= 7) {
+		ap->has_bssid = true;
+		memcpy(ap->bssid, b + 1, WLAN_MAC_LEN);
+		if (len == 8 || len == 9)
+			ap->bss_params = b[7];
+		if (len >= 11) {
+			ap->has_short_ssid = true;
+			ap->short_ssid = get_le32(b + 7);
+		}
+		if (len >= 12)
+			ap->bss_params = b[11];
+	}
+}
+
+int uwifi_ie_rnr(const struct uwifi_packet* p, struct uwifi_ie_rnr_ap* aps, int max)
+{
+	const struct information_element* ie = uwifi_ie_get(p, WLAN_IE_ID_RNR);
+	const unsigned char* b;
+	int len, cnt, info_len, i;
+	int num = 0;
+
+	if (ie == NULL)
+		return 0;
+
+	b = ie->var;
+	len = ie->len;
+	/* neighbor AP information fields */
+	while (len >= 4 && num < max) {
+		uint16_t hdr = get_le16(b);
+		cnt = ((hdr >> 4) & 0x0f) + 1;
+		info_len = hdr >> 8;
+		if (info_len == 0 || len < 4 + cnt * info_len)
+			break;
+
+		for (i = 0; i < cnt && num < max; i++) {
+			memset(&aps[num], 0, sizeof(aps[num]));
+			aps[num].op_class = b[2];
+			aps[num].chan = b[3];
+			rnr_tbtt_info(&aps[num], b + 4 + i * info_len, info_len);
+			num++;
+		}
+		b += 4 + cnt * info_len;
+		len -= 4 + cnt * info_len;
+	}
+	return num;
+}
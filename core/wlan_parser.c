@@ -10,6 +10,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <endian.h>
+#include <stddef.h>
 
 #include "platform.h"
 #include "wlan80211.h"
@@ -17,24 +18,125 @@
 #include "channel.h"
 #include "wlan_util.h"
 #include "wlan_parser.h"
+#include "beacon_cache.h"
+#include "wlan_ie.h"
+#include "stats.h"
 #include "log.h"
 
+static void ie_index_add(struct uwifi_packet* p, const struct information_element* ie,
+			 const unsigned char* buf)
+{
+	struct uwifi_ie_ref* ref;
+
+	if (p->wlan_ie_idx == NULL)
+		return;
+	if (p->wlan_ie_num >= UWIFI_IE_MAX) {
+		p->wlan_ie_truncated = true;
+		return;
+	}
+	ref = &p->wlan_ie_idx[p->wlan_ie_num++];
+	ref->id = ie->id;
+	ref->ext_id = ie->id == WLAN_IE_ID_EXT && ie->len > 0 ? ie->var[0] : 0;
+	ref->len = ie->len;
+	ref->off = buf - p->wlan_ies;
+}
+
+/* channel width field of HE 6GHz and EHT operation */
+static const enum uwifi_chan_width oper_width[] = {
+	CHAN_WIDTH_20, CHAN_WIDTH_40, CHAN_WIDTH_80, CHAN_WIDTH_160, CHAN_WIDTH_320
+};
+
+/* HE and EHT IEs use the element ID extension */
+static void parse_ie_ext(const struct information_element* ie, struct uwifi_packet* p)
+{
+	const unsigned char* b = ie->var + 1;
+	int len = ie->len - 1;
+	enum uwifi_chan_width w = CHAN_WIDTH_UNSPEC;
+	unsigned char rx, tx;
+	uint32_t params;
+	int off;
+
+	switch (ie->var[0]) {
+	case WLAN_IE_EXT_HE_CAPAB:
+		p->wlan_he = 1;
+		/* MAC and PHY capabilities, <= 80MHz MCS map */
+		if (len < 6 + 11 + 4)
+			break;
+		if (b[6] & WLAN_IE_HE_PHY_CAPAB_8080_5G)
+			w = CHAN_WIDTH_8080;
+		else if (b[6] & WLAN_IE_HE_PHY_CAPAB_160_5G)
+			w = CHAN_WIDTH_160;
+		else if (b[6] & WLAN_IE_HE_PHY_CAPAB_40_80_5G)
+			w = CHAN_WIDTH_80;
+		wlan_he_streams_from_mcs((unsigned char*)b + 6 + 11, &rx, &tx);
+		p->wlan_rx_streams = MAX(p->wlan_rx_streams, rx);
+		p->wlan_tx_streams = MAX(p->wlan_tx_streams, tx);
+		LOG_DBG("WLAN: IE: HE STREAMS %dx%d", p->wlan_tx_streams, p->wlan_rx_streams);
+		break;
+
+	case WLAN_IE_EXT_HE_OPER:
+		p->wlan_he = 1;
+		if (len < 6)
+			break;
+		params = b[0] | b[1] << 8 | b[2] << 16;
+		if (!(b[3] & 0x80)) /* BSS color disabled */
+			p->wlan_bss_color = b[3] & 0x3f;
+		off = 6;
+		if (params & WLAN_HE_OPER_VHT_INFO)
+			off += 3;
+		if (params & WLAN_HE_OPER_COHOSTED_BSS)
+			off += 1;
+		/* 6GHz beacons have no DSSS parameter set */
+		if (params & WLAN_HE_OPER_6GHZ_INFO && len >= off + 5) {
+			p->wlan_6g_channel = b[off];
+			w = oper_width[b[off + 1] & 0x03];
+		}
+		break;
+
+	case WLAN_IE_EXT_EHT_CAPAB:
+		p->wlan_he = 1;
+		p->wlan_eht = 1;
+		if (len >= 2 + 9 && (b[2] & WLAN_IE_EHT_PHY_CAPAB_320_6G))
+			w = CHAN_WIDTH_320;
+		break;
+
+	case WLAN_IE_EXT_EHT_OPER:
+		p->wlan_he = 1;
+		p->wlan_eht = 1;
+		if (len >= 5 + 3 && (b[0] & WLAN_EHT_OPER_INFO) && (b[5] & 0x07) <= 4)
+			w = oper_width[b[5] & 0x07];
+		break;
+	}
+
+	/* these come after the HT and VHT IEs */
+	if (w > p->wlan_chan_width)
+		p->wlan_chan_width = w;
+}
+
 void uwifi_parse_information_elements(unsigned char* buf, size_t bufLen, struct uwifi_packet *p)
 {
 	int len = bufLen;
+
+	p->wlan_ies = buf;
+	p->wlan_ie_num = 0;
+	p->wlan_ie_truncated = false;
+
 	while (len > 2) {
 		struct information_element* ie = (struct information_element*)buf;
 		//LOG_DBG("WLAN: IE: %d len %d t len %d", ie->id, ie->len, len);
 
+		/* only complete IEs are indexed, the decoders rely on it */
+		if (ie->len + 2 <= len)
+			ie_index_add(p, ie, buf);
+
 		switch (ie->id) {
 		case WLAN_IE_ID_SSID:
-			if (ie->len < WLAN_MAX_SSID_LEN-1) {
-				memcpy(p->wlan_essid, ie->var, ie->len);
-				p->wlan_essid[ie->len] = '\0';
-			} else {
-				memcpy(p->wlan_essid, ie->var, WLAN_MAX_SSID_LEN-1);
-				p->wlan_essid[WLAN_MAX_SSID_LEN-1] = '\0';
-			}
+			/* no copy, the SSID is referenced in the frame */
+			if (ie->len + 2 > len)
+				break;
+			p->wlan_essid = (const char*)ie->var;
+			p->wlan_essid_len = ie->len < WLAN_MAX_SSID_LEN-1 ?
+					    ie->len : WLAN_MAX_SSID_LEN-1;
 			break;
 
 		case WLAN_IE_ID_DSSS_PARAM:
@@ -81,6 +183,11 @@ void uwifi_parse_information_elements(unsigned char* buf, size_t bufLen, struct
 			}
 			break;
 
+		case WLAN_IE_ID_EXT:
+			if (ie->len > 0 && ie->len + 2 <= len)
+				parse_ie_ext(ie, p);
+			break;
+
 		case WLAN_IE_ID_VENDOR:
 			if (ie->len >= 4 &&
 			    ie->var[0] == 0x00 && ie->var[1] == 0x50 && ie->var[2] == 0xf2 && /* Microsoft OUI (00:50:F2) */
@@ -98,6 +205,21 @@ void uwifi_parse_information_elements(unsigned char* buf, size_t bufLen, struct
 
 /* return consumed length, 0 for stop parsing, or -1 on error */
 int uwifi_parse_80211_header(unsigned char* buf, size_t len, struct uwifi_packet* p)
+{
+	return uwifi_parse_80211_header_level(buf, len, p, UWIFI_PARSE_FULL);
+}
+
+/* same as above but information elements are only parsed for UWIFI_PARSE_FULL */
+int uwifi_parse_80211_header_level(unsigned char* buf, size_t len, struct uwifi_packet* p,
+				   enum uwifi_parse_level level)
+{
+	return uwifi_parse_80211_header_cached(buf, len, p, level, NULL);
+}
+
+/* same, and the IEs of beacons are looked up in @cache first if it is not NULL */
+int uwifi_parse_80211_header_cached(unsigned char* buf, size_t len, struct uwifi_packet* p,
+				    enum uwifi_parse_level level,
+				    struct uwifi_beacon_cache* cache)
 {
 	struct wlan_frame* wh = (struct wlan_frame*)buf;
 	uint16_t fc = le16toh(wh->fc);
@@ -107,9 +229,12 @@ int uwifi_parse_80211_header(unsigned char* buf, size_t len, struct uwifi_packet
 	uint8_t* bssid = NULL;
 
 	LOG_DBG("WLAN: LEN %zd", len);
+	UWIFI_STAT_INC(frames);
 
-	if (len < 10) /* minimum frame size (CTS/ACK) */
+	if (len < 10) { /* minimum frame size (CTS/ACK) */
+		UWIFI_STAT_INC(parse_err[UWIFI_PERR_HDR_SHORT]);
 		return -1;
+	}
 
 	p->wlan_mode = WLAN_MODE_UNKNOWN;
 	p->wlan_type = (fc & WLAN_FRAME_FC_MASK);
@@ -167,8 +292,10 @@ int uwifi_parse_80211_header(unsigned char* buf, size_t len, struct uwifi_packet
 			//wh->addr3 = DA (MSDU) or BSSID (A-MSDU)
 		}
 
-		if (len < hdrlen)
+		if (len < hdrlen) {
+			UWIFI_STAT_INC(parse_err[UWIFI_PERR_HDR_SHORT]);
 			return -1;
+		}
 
 		p->wlan_nav = le16toh(wh->duration);
 		LOG_DBG("WLAN: DATA NAV %d", p->wlan_nav);
@@ -195,16 +322,20 @@ int uwifi_parse_80211_header(unsigned char* buf, size_t len, struct uwifi_packet
 		else
 			hdrlen = 16;
 
-		if (len < hdrlen)
+		if (len < hdrlen) {
+			UWIFI_STAT_INC(parse_err[UWIFI_PERR_HDR_SHORT]);
 			return -1;
+		}
 
 	} else if (WLAN_FRAME_IS_MGMT(fc)) {
 		hdrlen = 24;
 		if (fc & WLAN_FRAME_FC_ORDER)
 			hdrlen += 4;
 
-		if (len < hdrlen)
+		if (len < hdrlen) {
+			UWIFI_STAT_INC(parse_err[UWIFI_PERR_HDR_SHORT]);
 			return -1;
+		}
 
 		p->wlan_fromds = fc & WLAN_FRAME_FC_FROM_DS;
 		p->wlan_tods = fc & WLAN_FRAME_FC_TO_DS;
@@ -219,6 +350,7 @@ int uwifi_parse_80211_header(unsigned char* buf, size_t len, struct uwifi_packet
 			p->wlan_retry = 1;
 	} else {
 		LOG_DBG("WLAN: !!!UNKNOWN FRAME!!!");
+		UWIFI_STAT_INC(parse_err[UWIFI_PERR_UNKNOWN_TYPE]);
 		return -1;
 	}
 
@@ -280,10 +412,15 @@ int uwifi_parse_80211_header(unsigned char* buf, size_t len, struct uwifi_packet
 			p->wlan_bintval = le16toh(bc->bintval);
 			//LOG_DBG("WLAN: TSF %u BINTVAL %u", p->wlan_tsf, p->wlan_bintval);
 
-			uwifi_parse_information_elements(bc->ie,
-				len - hdrlen - sizeof(struct wlan_frame_beacon) - 4 /* FCS */, p);
-			LOG_DBG("WLAN: ESSID %s", p->wlan_essid );
-			LOG_DBG("WLAN: CHAN %d", p->wlan_channel );
+			if (level >= UWIFI_PARSE_FULL) {
+				size_t ie_len = len - hdrlen - sizeof(struct wlan_frame_beacon) - 4 /* FCS */;
+				if (cache != NULL && p->wlan_type == WLAN_FRAME_BEACON)
+					uwifi_beacon_cache_parse(cache, wh->addr3, bc->ie, ie_len, p);
+				else
+					uwifi_parse_information_elements(bc->ie, ie_len, p);
+				LOG_DBG("WLAN: ESSID %.*s", p->wlan_essid_len, p->wlan_essid );
+				LOG_DBG("WLAN: CHAN %d", p->wlan_channel );
+			}
 			uint16_t cap_i = le16toh(bc->capab);
 			if (cap_i & WLAN_CAPAB_IBSS)
 				p->wlan_mode = WLAN_MODE_IBSS;
@@ -294,8 +431,9 @@ int uwifi_parse_80211_header(unsigned char* buf, size_t len, struct uwifi_packet
 			break;
 
 		case WLAN_FRAME_PROBE_REQ:
-			uwifi_parse_information_elements(buf + hdrlen,
-				len - hdrlen - 4 /* FCS */, p);
+			if (level >= UWIFI_PARSE_FULL)
+				uwifi_parse_information_elements(buf + hdrlen,
+					len - hdrlen - 4 /* FCS */, p);
 			p->wlan_mode = WLAN_MODE_PROBE;
 			break;
 
@@ -382,4 +520,237 @@ uint16_t uwifi_get_80211_header_fc(unsigned char* buf, size_t len)
 
 	struct wlan_frame* wh = (struct wlan_frame*)buf;
 	return le16toh(wh->fc);
-}
\ No newline at end of file
+}
+
+#define VIEW_A1		offsetof(struct wlan_frame, addr1)
+#define VIEW_A2		offsetof(struct wlan_frame, addr2)
+#define VIEW_A3		offsetof(struct wlan_frame, addr3)
+
+/* return false if the frame is too short or of unknown type */
+bool uwifi_frame_view_init(struct uwifi_frame_view* v, const unsigned char* buf, size_t len)
+{
+	const struct wlan_frame* wh = (const struct wlan_frame*)buf;
+	uint16_t fc;
+	size_t hdrlen;
+
+	if (len < 10) /* minimum frame size (CTS/ACK) */
+		return false;
+
+	fc = le16toh(wh->fc);
+	v->buf = buf;
+	v->len = len;
+	v->fc = fc;
+	v->ra_off = v->ta_off = v->bssid_off = 0;
+	v->ie_off = 0;
+
+	if (WLAN_FRAME_IS_DATA(fc)) {
+		hdrlen = 24;
+		if (WLAN_FRAME_IS_QOS(fc)) {
+			hdrlen += 2;
+			if (fc & WLAN_FRAME_FC_ORDER)
+				hdrlen += 4;
+		}
+
+		v->ra_off = VIEW_A1;
+		v->ta_off = VIEW_A2;
+
+		if ((fc & WLAN_FRAME_FC_FROM_DS) && (fc & WLAN_FRAME_FC_TO_DS)) {
+			hdrlen += 6;
+			if (len < hdrlen)
+				return false;
+			/* BSSID is only known for A-MSDU */
+			if (WLAN_FRAME_IS_QOS(fc) &&
+			    (le16toh(wh->u.addr4_qos_ht.qos) & WLAN_FRAME_QOS_AMSDU_PRESENT))
+				v->bssid_off = VIEW_A3;
+		} else if (fc & WLAN_FRAME_FC_FROM_DS) {
+			v->bssid_off = VIEW_A2;
+		} else if (fc & WLAN_FRAME_FC_TO_DS) {
+			v->bssid_off = VIEW_A1;
+		} else {
+			v->bssid_off = VIEW_A3;
+		}
+	} else if (WLAN_FRAME_IS_CTRL(fc)) {
+		switch (fc & WLAN_FRAME_FC_MASK) {
+		case WLAN_FRAME_CTS:
+		case WLAN_FRAME_ACK:
+			hdrlen = 10;
+			v->ra_off = VIEW_A1;
+			break;
+		case WLAN_FRAME_PSPOLL:
+			hdrlen = 16;
+			v->ra_off = v->bssid_off = VIEW_A1;
+			v->ta_off = VIEW_A2;
+			break;
+		case WLAN_FRAME_CF_END:
+		case WLAN_FRAME_CF_END_ACK:
+			hdrlen = 16;
+			v->ra_off = VIEW_A1;
+			v->ta_off = v->bssid_off = VIEW_A2;
+			break;
+		case WLAN_FRAME_RTS:
+		case WLAN_FRAME_BLKACK:
+		case WLAN_FRAME_BLKACK_REQ:
+			hdrlen = 16;
+			v->ra_off = VIEW_A1;
+			v->ta_off = VIEW_A2;
+			break;
+		default:
+			hdrlen = 16;
+			break;
+		}
+	} else if (WLAN_FRAME_IS_MGMT(fc)) {
+		hdrlen = 24;
+		if (fc & WLAN_FRAME_FC_ORDER)
+			hdrlen += 4;
+
+		v->ra_off = VIEW_A1;
+		v->ta_off = VIEW_A2;
+		v->bssid_off = VIEW_A3;
+
+		switch (fc & WLAN_FRAME_FC_MASK) {
+		case WLAN_FRAME_BEACON:
+		case WLAN_FRAME_PROBE_RESP:
+			v->ie_off = hdrlen + sizeof(struct wlan_frame_beacon);
+			break;
+		case WLAN_FRAME_PROBE_REQ:
+			v->ie_off = hdrlen;
+			break;
+		}
+	} else {
+		return false;
+	}
+
+	if (len < hdrlen)
+		return false;
+
+	/* IEs need at least the FCS after them */
+	if (v->ie_off && (size_t)v->ie_off + 4 > len)
+		v->ie_off = 0;
+
+	v->hdrlen = hdrlen;
+	return true;
+}
+
+/* same as wlan_mode in uwifi_parse_80211_header() */
+unsigned int uwifi_frame_view_mode(const struct uwifi_frame_view* v)
+{
+	uint16_t fc = v->fc;
+	uint16_t capab;
+
+	if (WLAN_FRAME_IS_DATA(fc)) {
+		if ((fc & WLAN_FRAME_FC_FROM_DS) && (fc & WLAN_FRAME_FC_TO_DS))
+			return WLAN_MODE_4ADDR;
+		else if (fc & WLAN_FRAME_FC_FROM_DS)
+			return WLAN_MODE_AP;
+		else if (fc & WLAN_FRAME_FC_TO_DS)
+			return WLAN_MODE_STA;
+		else
+			return WLAN_MODE_IBSS;
+	}
+
+	switch (fc & WLAN_FRAME_FC_MASK) {
+	case WLAN_FRAME_PROBE_REQ:
+		return WLAN_MODE_PROBE;
+	case WLAN_FRAME_BEACON:
+	case WLAN_FRAME_PROBE_RESP:
+		if (!uwifi_frame_view_beacon(v, NULL, NULL, &capab))
+			break;
+		if (capab & WLAN_CAPAB_IBSS)
+			return WLAN_MODE_IBSS;
+		else if (capab & WLAN_CAPAB_ESS)
+			return WLAN_MODE_AP;
+		break;
+	}
+	return WLAN_MODE_UNKNOWN;
+}
+
+unsigned int uwifi_frame_view_nav(const struct uwifi_frame_view* v)
+{
+	const struct wlan_frame* wh = (const struct wlan_frame*)v->buf;
+	return le16toh(wh->duration);
+}
+
+/* return sequence number, 0 for control frames which don't have one */
+unsigned int uwifi_frame_view_seqno(const struct uwifi_frame_view* v)
+{
+	const struct wlan_frame* wh = (const struct wlan_frame*)v->buf;
+
+	if (WLAN_FRAME_IS_CTRL(v->fc))
+		return 0;
+	return (le16toh(wh->seq) & WLAN_FRAME_SEQ_MASK) >> 4;
+}
+
+/* return TID for QoS data frames, 0 otherwise */
+unsigned char uwifi_frame_view_qos_class(const struct uwifi_frame_view* v)
+{
+	const struct wlan_frame* wh = (const struct wlan_frame*)v->buf;
+
+	if ((v->fc & WLAN_FRAME_FC_MASK) != WLAN_FRAME_QDATA)
+		return 0;
+	return le16toh(wh->u.qos) & WLAN_FRAME_QOS_TID_MASK;
+}
+
+/* fixed fields of beacons and probe responses, any pointer may be NULL */
+bool uwifi_frame_view_beacon(const struct uwifi_frame_view* v, uint64_t* tsf,
+			     unsigned int* bintval, uint16_t* capab)
+{
+	const struct wlan_frame_beacon* bc;
+	uint16_t type = v->fc & WLAN_FRAME_FC_MASK;
+
+	if ((type != WLAN_FRAME_BEACON && type != WLAN_FRAME_PROBE_RESP) ||
+	    v->len < v->hdrlen + sizeof(struct wlan_frame_beacon))
+		return false;
+
+	bc = (const struct wlan_frame_beacon*)(v->buf + v->hdrlen);
+	if (tsf)
+		*tsf = le64toh(bc->tsf);
+	if (bintval)
+		*bintval = le16toh(bc->bintval);
+	if (capab)
+		*capab = le16toh(bc->capab);
+	return true;
+}
+
+/* return pointer to IEs and their length without FCS, or NULL */
+const unsigned char* uwifi_frame_view_ies(const struct uwifi_frame_view* v, size_t* len)
+{
+	if (v->ie_off == 0)
+		return NULL;
+	*len = v->len - v->ie_off - 4 /* FCS */;
+	return v->buf + v->ie_off;
+}
+
+/* return first IE with this ID or NULL */
+const struct information_element* uwifi_frame_view_find_ie(const struct uwifi_frame_view* v, uint8_t id)
+{
+	const struct information_element* ie;
+	const unsigned char* buf;
+	size_t len;
+
+	buf = uwifi_frame_view_ies(v, &len);
+	if (buf == NULL)
+		return NULL;
+
+	while (len >= 2) {
+		ie = (const struct information_element*)buf;
+		if ((size_t)ie->len + 2 > len)
+			break;
+		if (ie->id == id)
+			return ie;
+		buf += ie->len + 2;
+		len -= ie->len + 2;
+	}
+	return NULL;
+}
+
+/* return pointer to SSID (not null terminated) or NULL if there is none */
+const unsigned char* uwifi_frame_view_ssid(const struct uwifi_frame_view* v, uint8_t* len)
+{
+	const struct information_element* ie;
+
+	ie = uwifi_frame_view_find_ie(v, WLAN_IE_ID_SSID);
+	if (ie == NULL)
+		return NULL;
+	*len = ie->len;
+	return ie->var;
+}
@@ -236,6 +236,61 @@ int wlan_vht_mcs_to_rate(enum uwifi_chan_width width, int streams, int mcs, bool
 	return 10.0 /* kpbs */ * streams * wf * mf / (sgi ? 3.6 : 4.0);
 }
 
+/*
+ * HE and EHT rates: data subcarriers * coded bits per subcarrier * streams
+ * divided by the OFDM symbol time of 12.8us plus guard interval
+ */
+
+/* coded bits per subcarrier times coding rate, times 12 */
+static const uint8_t he_mcs_bits12[14] = {
+	6, 12, 18, 24, 36, 48, 54, 60, 72, 80, 90, 100,	/* HE MCS 0 - 11 */
+	108, 120					/* EHT MCS 12, 13 */
+};
+
+/* symbol time in 100ns for a guard interval of 0.8, 1.6 and 3.2us */
+static const uint8_t he_sym_time[3] = { 136, 144, 160 };
+
+static int he_data_subcarriers(enum uwifi_chan_width width)
+{
+	switch (width) {
+		case CHAN_WIDTH_20: return 234;
+		case CHAN_WIDTH_40: return 468;
+		case CHAN_WIDTH_80: return 980;
+		case CHAN_WIDTH_160:
+		case CHAN_WIDTH_8080: return 1960;
+		case CHAN_WIDTH_320: return 3920;
+		default: return 0;
+	}
+}
+
+static int he_rate(enum uwifi_chan_width width, int streams, int mcs, int gi)
+{
+	int nsd = he_data_subcarriers(width);
+
+	if (nsd == 0 || gi < 0 || gi > 2 || streams < 1)
+		return -1;
+
+	/* 100kbps = bits/us * 10 */
+	return (int64_t)nsd * he_mcs_bits12[mcs] * streams * 100 / (12 * he_sym_time[gi]);
+}
+
+/* return rate in 100kbps or -1 when unsupported.
+ * gi: 0 for 0.8us, 1 for 1.6us, 2 for 3.2us */
+int wlan_he_mcs_to_rate(enum uwifi_chan_width width, int streams, int mcs, int gi)
+{
+	if (mcs < 0 || mcs > 11 || streams > 8 || width == CHAN_WIDTH_320)
+		return -1;
+	return he_rate(width, streams, mcs, gi);
+}
+
+/* same for EHT, which adds MCS 12 and 13 and 320MHz */
+int wlan_eht_mcs_to_rate(enum uwifi_chan_width width, int streams, int mcs, int gi)
+{
+	if (mcs < 0 || mcs > 13 || streams > 16)
+		return -1;
+	return he_rate(width, streams, mcs, gi);
+}
+
 enum uwifi_chan_width wlan_chan_width_from_vht_capab(uint32_t vht)
 {
 	switch (((vht & WLAN_IE_VHT_CAPAB_INFO_CHAN_WIDTH) >> 2)) {
@@ -287,6 +342,27 @@ void wlan_vht_streams_from_mcs(unsigned char* mcs, unsigned char* rx, unsigned c
 	*tx = i;
 }
 
+/* Note: mcs must be at least 4 bytes long, RX and TX map for <= 80MHz */
+void wlan_he_streams_from_mcs(unsigned char* mcs, unsigned char* rx, unsigned char* tx)
+{
+	int i;
+	/* RX */
+	uint16_t tmp = mcs[0] | (mcs[1] << 8);
+	for (i = 0; i < 8; i++) {
+		if (((tmp >> (i*2)) & 3) == 3)
+			break;
+	}
+	*rx = i;
+
+	/* TX */
+	tmp = mcs[2] | (mcs[3] << 8);
+	for (i = 0; i < 8; i++) {
+		if (((tmp >> (i*2)) & 3) == 3)
+			break;
+	}
+	*tx = i;
+}
+
 enum uwifi_80211_std wlan_80211std_from_chan(enum uwifi_chan_width width, int chan)
 {
 	switch (width) {
@@ -300,6 +376,8 @@ enum uwifi_80211_std wlan_80211std_from_chan(enum uwifi_chan_width width, int ch
 		case CHAN_WIDTH_160:
 		case CHAN_WIDTH_8080:
 			return IEEE80211_AC;
+		case CHAN_WIDTH_320:
+			return IEEE80211_BE;
 		default:
 			return IEEE80211_;
 	}
@@ -343,6 +421,18 @@ enum uwifi_80211_std wlan_80211std_from_type(uint16_t fc)
 	}
 }
 
+/* from the PHY header, VHT, HE or EHT */
+enum uwifi_80211_std wlan_80211std_from_phy(unsigned int phy_flags)
+{
+	if (phy_flags & PHY_FLAG_EHT)
+		return IEEE80211_BE;
+	else if (phy_flags & PHY_FLAG_HE)
+		return IEEE80211_AX;
+	else if (phy_flags & PHY_FLAG_VHT)
+		return IEEE80211_AC;
+	return IEEE80211_;
+}
+
 const char* wlan_80211std_str(enum uwifi_80211_std std)
 {
 	switch (std) {
@@ -352,6 +442,8 @@ const char* wlan_80211std_str(enum uwifi_80211_std std)
 		case IEEE80211_A: return "A";
 		case IEEE80211_N: return "N";
 		case IEEE80211_AC: return "AC";
+		case IEEE80211_AX: return "AX";
+		case IEEE80211_BE: return "BE";
 	}
 	return "?";
 }
@@ -384,6 +476,8 @@ int wlan_max_phy_rate(enum uwifi_chan_width width, unsigned char streams_rx)
 		case CHAN_WIDTH_160:
 		case CHAN_WIDTH_8080:
 			return wlan_vht_mcs_to_rate(width, streams_rx, 9, true);
+		case CHAN_WIDTH_320:
+			return wlan_eht_mcs_to_rate(width, streams_rx, 13, 0);
 	}
 	return 0;
 }
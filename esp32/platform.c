@@ -1,4 +1,5 @@
 #include <sys/time.h>
+#include <esp_timer.h>
 
 #include "platform.h"
 
@@ -8,3 +9,14 @@ uint32_t plat_time_usec(void)
 	gettimeofday(&tv, NULL);
 	return tv.tv_sec * 1000000 + tv.tv_usec;
 }
+
+/* esp_timer is a 64 bit usec timer since boot */
+uint64_t plat_time_ns(void)
+{
+	return (uint64_t)esp_timer_get_time() * 1000;
+}
+
+uint64_t plat_time_ns_coarse(void)
+{
+	return (uint64_t)esp_timer_get_time() * 1000;
+}
@@ -11,6 +11,20 @@
 #include "esp8266/esp_promisc.h"
 #include "core/wlan_parser.h"
 
+/* system_get_time() is a 32 bit usec counter, extend it to 64 bit. This has
+ * to be called at least once per wrap (~71 minutes) */
+uint64_t plat_time_ns(void)
+{
+	static uint32_t last;
+	static uint64_t high;
+	uint32_t now = system_get_time();
+
+	if (now < last)
+		high += 1ULL << 32;
+	last = now;
+	return (high + now) * 1000;
+}
+
 bool uwifi_esp_parse(uint8_t* buf, uint16_t len, struct uwifi_packet* pkt)
 {
 	struct sniffer_buf* sb;
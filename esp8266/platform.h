@@ -24,5 +24,8 @@
 #define sprintf			os_sprintf
 
 #define plat_time_usec		system_get_time
+#define plat_time_ns_coarse	plat_time_ns
+
+uint64_t plat_time_ns(void);
 
 #define log_out(_l, ...)	os_printf(__VA_ARGS__)
@@ -0,0 +1,105 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_BEACON_CACHE_H_
+#define _UWIFI_BEACON_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "wlan80211.h"
+#include "channel.h"
+#include "mac_hash.h"
+#include "wlan_parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Beacon deduplication cache
+ *
+ * APs send almost the same beacon every beacon interval. The cache keeps a
+ * copy of the information elements of the last beacon of every BSSID together
+ * with the values parsed from them. When the next beacon has the same IEs
+ * these values are copied into the packet and its IE index points to the
+ * cached one, instead of parsing the IEs again. Comparing the IEs is much
+ * cheaper than parsing them. The TIM element changes with every DTIM count and
+ * is not compared, its position is remembered so a lookup does not have to
+ * walk the IEs. The fixed fields
+ * (TSF, beacon interval, capabilities) are always parsed.
+ *
+ * When the cache is full the least recently used BSSIDs are replaced (second
+ * chance / CLOCK). A cache is not thread safe, use one per thread.
+ */
+
+#define UWIFI_BEACON_CACHE_MAX		256	/* default max number of BSSIDs */
+
+struct uwifi_beacon_entry {
+	uint64_t		key;		/* BSSID */
+	unsigned char*		ies;		/* copy of the IEs, NULL if
+						 * not valid */
+	uint16_t		ie_len;
+	uint16_t		tim_off;	/* UINT16_MAX if not indexed */
+	uint8_t			tim_len;
+	bool			used;		/* hit since the last sweep */
+
+	/* values from uwifi_parse_information_elements() */
+	uint16_t		essid_off;	/* UINT16_MAX if no SSID */
+	unsigned char		essid_len;
+	unsigned char		channel;
+	unsigned char		channel_6g;
+	enum uwifi_chan_width	chan_width;
+	unsigned char		tx_streams;
+	unsigned char		rx_streams;
+	unsigned char		bss_color;
+	unsigned int		wpa:1,
+				rsn:1,
+				ht40plus:1,
+				he:1,
+				eht:1,
+				ie_truncated:1;
+
+	/* the offsets are the same as long as the IEs are the same */
+	unsigned char		ie_num;
+	struct uwifi_ie_ref	ie_idx[UWIFI_IE_MAX];
+};
+
+struct uwifi_beacon_cache {
+	struct uwifi_beacon_entry* entries;
+	unsigned int		num;
+	unsigned int		size;
+	unsigned int		hand;		/* next entry to check for
+						 * replacement */
+	struct mac_hash		idx;		/* BSSID -> entry index + 1 */
+	unsigned int		max;		/* max number of BSSIDs, 0 for
+						 * UWIFI_BEACON_CACHE_MAX */
+	uint64_t		hits;
+	uint64_t		misses;
+	uint64_t		evictions;
+};
+
+/* a zeroed cache is valid too */
+void uwifi_beacon_cache_init(struct uwifi_beacon_cache* bc);
+
+void uwifi_beacon_cache_free(struct uwifi_beacon_cache* bc);
+
+/* parse the IEs of a beacon from @bssid into @p, or copy the values from the
+ * cache if they did not change since the last beacon. The IE index is kept in
+ * the cache, p->wlan_ie_idx points there and is valid until the next call.
+ * Return true on a cache hit */
+bool uwifi_beacon_cache_parse(struct uwifi_beacon_cache* bc, const unsigned char* bssid,
+			      unsigned char* ies, size_t len, struct uwifi_packet* p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
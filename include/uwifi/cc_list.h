@@ -205,6 +205,32 @@ static inline void cc_list_add_tail_(struct cc_list_head *h,
 	(void)cc_list_debug(h, abortstr);
 }
 
+/**
+ * list_add_after - add an entry after an existing node in a linked list
+ * @h: the list_head to add the node to (for debugging)
+ * @p: the existing list_node to add the node after
+ * @n: the new list_node to add to the list.
+ *
+ * The existing list_node must already be a member of the list.
+ * The new list_node does not need to be initialized; it will be overwritten.
+ *
+ * Example:
+ *	list_add_after(&parent->children, &child1->list, &child2->list);
+ *	parent->num_children++;
+ */
+#define cc_list_add_after(h, p, n) cc_list_add_after_(h, p, n, LIST_LOC)
+static inline void cc_list_add_after_(struct cc_list_head *h,
+				   struct cc_list_node *p,
+				   struct cc_list_node *n,
+				   __attribute__((unused)) const char *abortstr)
+{
+	n->next = p->next;
+	n->prev = p;
+	p->next->prev = n;
+	p->next = n;
+	(void)cc_list_debug(h, abortstr);
+}
+
 /**
  * list_empty - is a list empty?
  * @h: the list_head
@@ -419,7 +445,7 @@ static inline const void *cc_list_tail_(const struct cc_list_head *h, size_t off
  *		printf("Name: %s\n", child->name);
  */
 #define cc_list_for_each_rev(h, i, member)					\
-	for (i = container_of_var(list_debug(h,	LIST_LOC)->n.prev, i, member); \
+	for (i = container_of_var(cc_list_debug(h, LIST_LOC)->n.prev, i, member); \
 	     &i->member != &(h)->n;					\
 	     i = container_of_var(i->member.prev, i, member))
 
@@ -28,6 +28,7 @@ enum uwifi_chan_width {
 	CHAN_WIDTH_80,
 	CHAN_WIDTH_160,
 	CHAN_WIDTH_8080,
+	CHAN_WIDTH_320,
 };
 
 /* channel to frequency mapping */
@@ -14,6 +14,7 @@
 #include "wlan80211.h"
 #include "channel.h"
 #include "platform.h"
+#include "node.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,15 +33,15 @@ struct uwifi_interface {
 
 	/* not config but state */
 	int			sock;
-	struct cc_list_head	wlan_nodes;
-	uint32_t		last_nodetimeout;
+	struct uwifi_nodes	wlan_nodes;
+	uint64_t		last_nodetimeout;	/* plat_time_ns() */
 	struct uwifi_channels	channels;
 	int			num_channels;
 	bool			channel_initialized;
 
 	int			channel_idx;		/* index into channels array */
 	struct uwifi_chan_spec	channel;		/* current channel */
-	uint32_t		last_channelchange;
+	uint64_t		last_channelchange;	/* plat_time_ns() */
 
 	int			if_phy;
 	unsigned int		max_phy_rate;
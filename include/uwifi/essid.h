@@ -10,28 +10,63 @@
 #ifndef UWIFI_ESSID_H_
 #define UWIFI_ESSID_H_
 
+#include <stdint.h>
+
 #include "cc_list.h"
 #include "wlan80211.h"
+#include "mac_hash.h"
+#include "pool.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct uwifi_essids;
+struct uwifi_ssid_table;
+
 struct essid_info {
 	struct cc_list_node	list;
 	char			essid[WLAN_MAX_SSID_LEN];
+	unsigned char		essid_len;	/* SSIDs may contain NUL */
 	struct cc_list_head	nodes;
 	unsigned int		num_nodes;
 	int			split;
+	struct uwifi_essids*	essids;		/* table we belong to */
+	uint32_t		hash;
+	uint32_t		ssid_id;	/* SSID table ID or 0 */
+	struct essid_info*	hnext;		/* hash bucket chain */
+	struct mac_hash		bssids;		/* BSSID -> number of non-AP nodes,
+						 * split if more than one */
+};
+
+/* ESSID table: list in order of appearance and hash index by SSID. Packets
+ * with wlan_ssid_id set are found by ID, these have to come from one
+ * SSID table (see ssid_table.h) per ESSID table. If ssids is set,
+ * uwifi_essids_update() interns the packets there */
+struct uwifi_essids {
+	struct cc_list_head	list;
+	struct uwifi_pool*	pool;		/* optional, for objects of
+						 * sizeof(struct essid_info) */
+	struct essid_info**	idx;
+	unsigned int		idx_size;	/* power of 2 */
+	unsigned int		num;
+	struct essid_info**	by_id;		/* SSID table ID -> ESSID */
+	unsigned int		by_id_size;
+	struct uwifi_ssid_table* ssids;		/* optional, not owned */
 };
 
 struct uwifi_node;
 struct uwifi_packet;
 
-void uwifi_essids_update(struct cc_list_head* essids, struct uwifi_packet* p,
+void uwifi_essids_init(struct uwifi_essids* essids);
+void uwifi_essids_update(struct uwifi_essids* essids, struct uwifi_packet* p,
 			 struct uwifi_node* n);
+void uwifi_essids_add_node(struct uwifi_essids* essids, const char* essid,
+			   struct uwifi_node* n);
+void uwifi_essids_add_node_len(struct uwifi_essids* essids, const char* essid,
+			       unsigned int len, struct uwifi_node* n);
 void uwifi_essids_remove_node(struct uwifi_node* n);
-void uwifi_essids_free(struct cc_list_head* essids);
+void uwifi_essids_free(struct uwifi_essids* essids);
 
 #ifdef __cplusplus
 }
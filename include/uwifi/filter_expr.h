@@ -0,0 +1,85 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_FILTER_EXPR_H_
+#define _UWIFI_FILTER_EXPR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wlan80211.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Userspace frame filter expressions
+ *
+ * Expressions are compiled once into a compact bytecode which is evaluated
+ * against a parsed packet and optionally the node which sent it. Example:
+ *
+ *	type == beacon && signal > -70 && (essid ~ "guest*" || !wpa)
+ *	ta == 00:11:22:33:44:55 || node.pkts >= 100 && node.mode & ap
+ *
+ * Operators: || && ! ( ) and the comparisons == != < <= > >= for numbers,
+ * & for bits set, == != for MAC addresses and == != ~ (glob with * and ?)
+ * for strings. "and", "or" and "not" can be used instead of && || !. A
+ * number field without comparison is true if it is not zero.
+ *
+ * Packet fields: type class signal rate freq channel len mode seqno retry
+ * wep wpa rsn width tx_streams rx_streams bintval qos nav injected badfcs
+ * ta ra bssid essid
+ *
+ * Node fields: node.pkts node.mode node.channel node.std node.sig_max
+ * node.retries node.essid. Comparisons with node fields are false if there
+ * is no node.
+ *
+ * Names for values: frame types (beacon, probe_req, probe_resp, auth, deauth,
+ * assoc_req, assoc_resp, reassoc_req, reassoc_resp, disassoc, action, data,
+ * qdata, null, qos_null, rts, cts, ack, pspoll, blkack, blkack_req), classes
+ * (mgmt, ctrl, data) and modes (ap, sta, ibss, probe, 4addr).
+ */
+
+struct uwifi_expr_insn {
+	uint8_t			op;
+	uint8_t			field;
+	uint8_t			cmp;
+	int32_t			val;	/* value, constant index or jump target */
+};
+
+struct uwifi_expr_const {
+	uint8_t			mac[WLAN_MAC_LEN];
+	char			str[WLAN_MAX_SSID_LEN];
+};
+
+struct uwifi_expr {
+	struct uwifi_expr_insn*	insn;
+	unsigned int		num;
+	struct uwifi_expr_const* consts;
+	unsigned int		num_consts;
+};
+
+struct uwifi_packet;
+struct uwifi_node;
+
+/* return true on success, on error the position is logged */
+bool uwifi_expr_compile(struct uwifi_expr* e, const char* str);
+
+/* @n may be NULL. An empty expression matches everything */
+bool uwifi_expr_match(const struct uwifi_expr* e, const struct uwifi_packet* p,
+		      const struct uwifi_node* n);
+
+void uwifi_expr_free(struct uwifi_expr* e);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_MAC_HASH_H_
+#define _UWIFI_MAC_HASH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Open addressing hash table (linear probing) which maps a 48 bit MAC address,
+ * stored in a uint64_t, to a pointer. A zeroed struct is a valid empty table,
+ * memory is allocated on first insert.
+ */
+
+struct mac_hash_entry {
+	uint64_t		key;
+	void*			val;	/* NULL marks an empty slot */
+};
+
+struct mac_hash {
+	struct mac_hash_entry*	tbl;
+	unsigned int		size;	/* power of 2 */
+	unsigned int		num;
+};
+
+static inline uint64_t mac_to_u64(const unsigned char* mac)
+{
+	return (uint64_t)mac[0] << 40 | (uint64_t)mac[1] << 32 |
+	       (uint64_t)mac[2] << 24 | (uint64_t)mac[3] << 16 |
+	       (uint64_t)mac[4] << 8 | (uint64_t)mac[5];
+}
+
+void* mac_hash_get(const struct mac_hash* h, uint64_t key);
+bool mac_hash_put(struct mac_hash* h, uint64_t key, void* val);
+void* mac_hash_del(struct mac_hash* h, uint64_t key);
+void mac_hash_free(struct mac_hash* h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,7 +14,8 @@
 #include "wlan_parser.h"
 #include "cc_list.h"
 #include "average.h"
-#include "conf.h"
+#include "mac_hash.h"
+#include "pool.h"
 #include "essid.h"
 #include "wlan_util.h"
 
@@ -25,13 +26,14 @@ extern "C" {
 struct uwifi_node {
 	/* housekeeping */
 	struct cc_list_node	list;								// X
+	struct cc_list_node	lru_list;	/* ordered by last_seen */
 	struct cc_list_node	essid_nodes;
 	struct cc_list_head	on_channels;	/* channels this node was seen on */
 	struct cc_list_head	ap_nodes;	/* stations associated to AP */
 	struct cc_list_node	ap_list;
 	struct uwifi_node*	ap_node;
 	unsigned int		num_on_channels;
-	uint32_t		last_seen;	/* timestamp */					// X uint32
+	uint64_t		last_seen;	/* plat_time_ns() */
 
 	/* general packet info */
 	unsigned int		pkt_types;	/* bitmask of packet types we've seen */
@@ -58,17 +60,26 @@ struct uwifi_node {
 	unsigned int		wlan_retries_last;
 	unsigned int		wlan_seqno;
 	struct essid_info*	essid;
+	uint64_t		essid_bssid;	/* BSSID counted for split status */
 	enum uwifi_chan_width	wlan_chan_width;
+	enum uwifi_80211_std	wlan_std;
 	unsigned char		wlan_tx_streams;
 	unsigned char		wlan_rx_streams;
-	enum uwifi_80211_std	wlan_std;
+	unsigned char		wlan_bss_color;	/* HE BSS color, 0 if unknown */
+	unsigned char		wlan_6g_channel; /* 6GHz primary channel, 0 if unknown */
+	bool			essid_counted;
 
 	unsigned int		wlan_wep:1,	/* WEP active? */
 				wlan_wpa:1,
 				wlan_rsn:1,
 				wlan_ht40plus:1;
 
+	/* rarely used, allocated when the application provides such info */
+	struct uwifi_node_ext*	ext;
+};
 
+/* information above 802.11 which is only known for few nodes */
+struct uwifi_node_ext {
 	/* batman */
 	unsigned char		bat_gw:1;
 
@@ -79,14 +90,34 @@ struct uwifi_node {
 	unsigned int		olsr_tc;	/* unused */
 };
 
+/* node table: list in order of appearance, LRU list for expiry and hash
+ * index by MAC */
+struct uwifi_nodes {
+	struct cc_list_head	list;
+	struct cc_list_head	lru;		/* oldest first */
+	struct mac_hash		idx;
+	struct uwifi_pool*	pool;		/* optional, for objects of
+						 * sizeof(struct uwifi_node) */
+	struct uwifi_pool*	ext_pool;	/* optional, for objects of
+						 * sizeof(struct uwifi_node_ext) */
+	uint64_t		insert_fail;	/* new nodes which could not be
+						 * added (pool full, no memory) */
+};
+
+void uwifi_nodes_init(struct uwifi_nodes* nodes);
+struct uwifi_node* uwifi_node_find(struct uwifi_nodes* nodes,
+				   const unsigned char* mac);
 struct uwifi_node* uwifi_node_update(struct uwifi_packet* p,
-				     struct cc_list_head* nodes);
+				     struct uwifi_nodes* nodes);
 struct uwifi_node* uwifi_node_update_receiver(struct uwifi_packet* p,
-					      struct cc_list_head* nodes);
-void uwifi_nodes_find_ap(struct uwifi_node* n, struct cc_list_head* nodes);
-void uwifi_nodes_timeout(struct cc_list_head* nodes, unsigned int timeout_sec,
-			 uint32_t* last_nodetimeout);
-void uwifi_nodes_free(struct cc_list_head* nodes);
+					      struct uwifi_nodes* nodes);
+void uwifi_nodes_find_ap(struct uwifi_node* n, struct uwifi_nodes* nodes);
+void uwifi_nodes_timeout(struct uwifi_nodes* nodes, unsigned int timeout_sec,
+			 uint64_t* last_nodetimeout, uint64_t now);
+struct uwifi_node* uwifi_node_merge(const struct uwifi_node* src,
+				    struct uwifi_nodes* nodes);
+void uwifi_nodes_sort_lru(struct uwifi_nodes* nodes);
+void uwifi_nodes_free(struct uwifi_nodes* nodes);
 
 #ifdef __cplusplus
 }
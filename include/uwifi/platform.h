@@ -15,7 +15,9 @@
 extern "C" {
 #endif
 
-uint32_t plat_time_usec(void);	// return monotonic time in usec
+uint32_t plat_time_usec(void);	// return monotonic time in usec, wraps after ~71 min
+uint64_t plat_time_ns(void);	// return monotonic time in nsec
+uint64_t plat_time_ns_coarse(void); // same but cheaper, only with clock tick resolution
 
 #ifdef __cplusplus
 }
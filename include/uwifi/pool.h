@@ -0,0 +1,74 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_POOL_H_
+#define _UWIFI_POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed size object pool
+ *
+ * Objects are carved out of larger chunks and recycled through a free list, so
+ * frequent allocation and release of same-sized objects (nodes, ESSIDs) does
+ * not fragment the heap. Chunks are only returned when the pool is destroyed.
+ * A pool is not thread safe, use one pool per thread.
+ */
+
+struct pool_obj;
+struct pool_chunk;
+
+struct uwifi_pool {
+	/* config */
+	size_t			obj_size;
+	unsigned int		chunk_objs;	/* objects per chunk */
+	unsigned int		max_objs;	/* hard cap, 0 for no limit */
+	bool			hugepages;	/* try to back chunks by hugepages */
+
+	/* state */
+	unsigned int		num_used;
+	unsigned int		num_total;
+	struct pool_obj*	free_list;
+	struct pool_chunk*	chunks;
+};
+
+/**
+ * uwifi_pool_init() - initialize object pool
+ *
+ * @pool: pool
+ * @obj_size: size of one object
+ * @chunk_objs: number of objects allocated at once (0 for default). When
+ *	hugepages are used a chunk is one hugepage and this is ignored.
+ * @max_objs: maximum number of objects, uwifi_pool_alloc() fails beyond that
+ *	(0 for unlimited)
+ * @hugepages: try to back chunks with hugepages (Linux only), falls back to
+ *	normal pages if none are available
+ */
+void uwifi_pool_init(struct uwifi_pool* pool, size_t obj_size,
+		     unsigned int chunk_objs, unsigned int max_objs,
+		     bool hugepages);
+
+/* return zeroed object or NULL if the cap is reached or out of memory */
+void* uwifi_pool_alloc(struct uwifi_pool* pool);
+
+void uwifi_pool_free(struct uwifi_pool* pool, void* obj);
+
+/* release all memory, all objects of the pool become invalid */
+void uwifi_pool_destroy(struct uwifi_pool* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_SSID_TABLE_H_
+#define _UWIFI_SSID_TABLE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wlan80211.h"
+#include "mac_hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * SSID intern table
+ *
+ * Maps each distinct SSID (length and bytes, may contain NUL) to a small
+ * stable ID starting at 1, so SSIDs can be compared and indexed as integers.
+ * IDs are never reused until the table is freed. A per-BSSID cache of the
+ * last SSID ID skips hashing for the common case of an AP sending the same
+ * SSID in every beacon. A table is not thread safe, use one per thread.
+ */
+
+struct uwifi_ssid_entry {
+	uint32_t		hash;
+	unsigned char		len;
+	char			ssid[WLAN_MAX_SSID_LEN];	/* NUL terminated */
+};
+
+struct uwifi_ssid_table {
+	struct uwifi_ssid_entry* entries;	/* ID - 1 */
+	unsigned int		num;
+	unsigned int		size;
+	uint32_t*		idx;		/* hash index of IDs, 0 empty */
+	unsigned int		idx_size;	/* power of 2 */
+	struct mac_hash		bssid_cache;	/* BSSID -> last ID */
+	unsigned int		max;		/* max number of SSIDs, 0 for
+						 * no limit */
+};
+
+struct uwifi_packet;
+
+/* FNV-1a over length and bytes */
+uint32_t uwifi_ssid_hash(const char* ssid, unsigned int len);
+
+/* a zeroed table is valid too */
+void uwifi_ssid_table_init(struct uwifi_ssid_table* t);
+
+void uwifi_ssid_table_free(struct uwifi_ssid_table* t);
+
+/* return ID for SSID, adding it if necessary, or 0 if the table is full or
+ * out of memory */
+uint32_t uwifi_ssid_intern(struct uwifi_ssid_table* t, const char* ssid,
+			   unsigned int len);
+
+/* same, but first check the last SSID seen from @bssid */
+uint32_t uwifi_ssid_intern_bssid(struct uwifi_ssid_table* t, const unsigned char* bssid,
+				 const char* ssid, unsigned int len);
+
+/* set p->wlan_ssid_id from the parsed SSID of a beacon or probe response */
+uint32_t uwifi_ssid_intern_packet(struct uwifi_ssid_table* t, struct uwifi_packet* p);
+
+/* return SSID for ID or NULL. The pointer is valid until the next SSID is
+ * added to the table */
+const char* uwifi_ssid_get(const struct uwifi_ssid_table* t, uint32_t id,
+			   unsigned int* len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_STATS_H_
+#define _UWIFI_STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Optional instrumentation counters, enabled with STATS=1 (UWIFI_STATS).
+ *
+ * Each thread increments its own counter block without locking or atomics,
+ * so the cost in the hot path is a thread local increment. When disabled the
+ * macros compile to nothing and uwifi_stats_snapshot() returns false.
+ */
+
+enum uwifi_parse_err {
+	UWIFI_PERR_PHY_SHORT,		/* too short for PHY header */
+	UWIFI_PERR_PHY_MALFORMED,	/* bad radiotap header */
+	UWIFI_PERR_HDR_SHORT,		/* too short for 802.11 header */
+	UWIFI_PERR_UNKNOWN_TYPE,	/* reserved frame type */
+	UWIFI_PERR_ARPHDR,		/* unsupported ARPHRD */
+	UWIFI_PERR_MAX
+};
+
+struct uwifi_stats {
+	/* parser */
+	uint64_t	frames;			/* 802.11 headers parsed */
+	uint64_t	phy_headers;		/* radiotap or prism headers */
+	uint64_t	parse_err[UWIFI_PERR_MAX];
+	uint64_t	bad_fcs;
+	uint64_t	beacon_cache_hits;	/* IEs not parsed again */
+	uint64_t	beacon_cache_misses;
+
+	/* nodes */
+	uint64_t	node_inserts;
+	uint64_t	node_evictions;		/* by uwifi_nodes_timeout() */
+	uint64_t	node_alloc_fail;
+
+	/* MAC hash */
+	uint64_t	hash_lookups;
+	uint64_t	hash_probes;		/* slots compared in lookups */
+	uint64_t	hash_probe_max;
+
+	/* channels */
+	uint64_t	chan_changes;
+	uint64_t	chan_change_fail;
+};
+
+#if UWIFI_STATS
+
+struct uwifi_stats_block {
+	struct uwifi_stats		s;
+	bool				registered;
+	struct uwifi_stats_block*	next;
+};
+
+extern __thread struct uwifi_stats_block uwifi_stats_local;
+
+void uwifi_stats_register(void);
+
+static inline struct uwifi_stats* uwifi_stats_get_local(void)
+{
+	if (__builtin_expect(!uwifi_stats_local.registered, 0))
+		uwifi_stats_register();
+	return &uwifi_stats_local.s;
+}
+
+#define UWIFI_STAT_INC(_f)	(uwifi_stats_get_local()->_f++)
+#define UWIFI_STAT_ADD(_f, _v)	(uwifi_stats_get_local()->_f += (_v))
+#define UWIFI_STAT_MAX(_f, _v)	do { struct uwifi_stats* _s = uwifi_stats_get_local(); \
+					if ((_v) > _s->_f) _s->_f = (_v); } while (0)
+
+#else
+
+#define UWIFI_STAT_INC(_f)	do { } while (0)
+#define UWIFI_STAT_ADD(_f, _v)	do { } while (0)
+#define UWIFI_STAT_MAX(_f, _v)	do { } while (0)
+
+#endif
+
+/* sum of all threads, including exited ones. Counters of other threads are
+ * read without locking and may be slightly behind. Return false when
+ * compiled without UWIFI_STATS */
+bool uwifi_stats_snapshot(struct uwifi_stats* s);
+
+/* counters of the calling thread only */
+bool uwifi_stats_snapshot_thread(struct uwifi_stats* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
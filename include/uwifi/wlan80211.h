@@ -173,13 +173,25 @@ struct information_element {
 #define WLAN_IE_ID_SSID		0
 #define WLAN_IE_ID_SUPP_RATES	1
 #define WLAN_IE_ID_DSSS_PARAM	3
+#define WLAN_IE_ID_TIM		5
+#define WLAN_IE_ID_COUNTRY	7
+#define WLAN_IE_ID_BSS_LOAD	11
 #define WLAN_IE_ID_HT_CAPAB	45
 #define WLAN_IE_ID_RSN		48
 #define WLAN_IE_ID_HT_OPER	61
+#define WLAN_IE_ID_EXT_CAPAB	127
 #define WLAN_IE_ID_VHT_CAPAB	191
 #define WLAN_IE_ID_VHT_OPER	192
 #define WLAN_IE_ID_VHT_OMN	199
+#define WLAN_IE_ID_RNR		201
 #define WLAN_IE_ID_VENDOR	221
+#define WLAN_IE_ID_EXT		255	/* element ID extension in var[0] */
+
+/* element ID extensions */
+#define WLAN_IE_EXT_HE_CAPAB	35
+#define WLAN_IE_EXT_HE_OPER	36
+#define WLAN_IE_EXT_EHT_OPER	106
+#define WLAN_IE_EXT_EHT_CAPAB	108
 
 /* HT capability info */
 // present in Beacon, Assoc Req/Resp, Reassoc Req/Resp, Probe Req/Resp, Mesh Peering Open/Close
@@ -193,6 +205,14 @@ struct information_element {
 #define WLAN_IE_VHT_CAPAB_INFO_CHAN_WIDTH_160	1 /* 160MHz */
 #define WLAN_IE_VHT_CAPAB_INFO_CHAN_WIDTH_BOTH	2 /* 160MHz and 80+80 MHz */
 
+/* HE PHY capabilities, channel width set in the first byte */
+#define WLAN_IE_HE_PHY_CAPAB_40_80_5G		0x04
+#define WLAN_IE_HE_PHY_CAPAB_160_5G		0x08
+#define WLAN_IE_HE_PHY_CAPAB_8080_5G		0x10
+
+/* EHT PHY capabilities, first byte */
+#define WLAN_IE_EHT_PHY_CAPAB_320_6G		0x02
+
 #define WLAN_MAX_SSID_LEN	34
 
 #define WLAN_MAC_LEN		6
@@ -0,0 +1,177 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_WLAN_IE_H_
+#define _UWIFI_WLAN_IE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wlan80211.h"
+#include "wlan_parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Decoders for information elements
+ *
+ * uwifi_parse_information_elements() records the position of every IE in the
+ * index wlan_ie_idx of the packet, which the caller or a beacon cache provides.
+ * Without it no IEs are found. The functions here find IEs in this index and decode
+ * them only when they are called, so the parser does not pay for fields
+ * nobody uses. They read from the frame buffer, which has to be still valid.
+ * Fields which are not present in a short IE are left zero.
+ */
+
+/* cipher and AKM suites: OUI << 8 | type */
+#define WLAN_SUITE(_oui, _type)		((uint32_t)(_oui) << 8 | (_type))
+#define WLAN_OUI_IEEE			0x000fac
+#define WLAN_OUI_MICROSOFT		0x0050f2
+
+#define WLAN_CIPHER_WEP40		WLAN_SUITE(WLAN_OUI_IEEE, 1)
+#define WLAN_CIPHER_TKIP		WLAN_SUITE(WLAN_OUI_IEEE, 2)
+#define WLAN_CIPHER_CCMP		WLAN_SUITE(WLAN_OUI_IEEE, 4)
+#define WLAN_CIPHER_WEP104		WLAN_SUITE(WLAN_OUI_IEEE, 5)
+#define WLAN_CIPHER_BIP_CMAC		WLAN_SUITE(WLAN_OUI_IEEE, 6)
+#define WLAN_CIPHER_GCMP		WLAN_SUITE(WLAN_OUI_IEEE, 8)
+#define WLAN_CIPHER_GCMP_256		WLAN_SUITE(WLAN_OUI_IEEE, 9)
+#define WLAN_CIPHER_CCMP_256		WLAN_SUITE(WLAN_OUI_IEEE, 10)
+
+#define WLAN_AKM_8021X			WLAN_SUITE(WLAN_OUI_IEEE, 1)
+#define WLAN_AKM_PSK			WLAN_SUITE(WLAN_OUI_IEEE, 2)
+#define WLAN_AKM_FT_8021X		WLAN_SUITE(WLAN_OUI_IEEE, 3)
+#define WLAN_AKM_FT_PSK			WLAN_SUITE(WLAN_OUI_IEEE, 4)
+#define WLAN_AKM_PSK_SHA256		WLAN_SUITE(WLAN_OUI_IEEE, 6)
+#define WLAN_AKM_SAE			WLAN_SUITE(WLAN_OUI_IEEE, 8)
+#define WLAN_AKM_FT_SAE			WLAN_SUITE(WLAN_OUI_IEEE, 9)
+#define WLAN_AKM_8021X_SUITE_B_192	WLAN_SUITE(WLAN_OUI_IEEE, 12)
+#define WLAN_AKM_OWE			WLAN_SUITE(WLAN_OUI_IEEE, 18)
+#define WLAN_AKM_SAE_EXT		WLAN_SUITE(WLAN_OUI_IEEE, 24)
+
+#define WLAN_RSN_CAPAB_MFP_REQUIRED	0x0040
+#define WLAN_RSN_CAPAB_MFP_CAPABLE	0x0080
+
+#define UWIFI_IE_RSN_MAX_SUITES		4
+
+struct uwifi_ie_rsn {
+	uint16_t	version;
+	uint32_t	group_cipher;
+	uint32_t	group_mgmt_cipher;	/* 0 if not present */
+	uint8_t		num_pairwise;		/* may be more than stored */
+	uint32_t	pairwise[UWIFI_IE_RSN_MAX_SUITES];
+	uint8_t		num_akm;
+	uint32_t	akm[UWIFI_IE_RSN_MAX_SUITES];
+	uint16_t	capab;
+};
+
+#define UWIFI_IE_COUNTRY_MAX		16
+
+struct uwifi_ie_country {
+	char		cc[3];			/* NUL terminated */
+	char		env;			/* ' ', 'O'utdoor, 'I'ndoor or 'X' */
+	uint8_t		num;
+	struct {
+		uint8_t	first_chan;
+		uint8_t	num_chans;
+		int8_t	max_power;		/* dBm */
+	} sub[UWIFI_IE_COUNTRY_MAX];
+};
+
+struct uwifi_ie_bss_load {
+	uint16_t	sta_count;
+	uint8_t		chan_util;		/* busy time in 1/255 */
+	uint16_t	adm_capacity;		/* in 32us/s */
+};
+
+struct uwifi_ie_he_capab {
+	uint8_t		mac_capab[6];
+	uint8_t		phy_capab[11];
+	uint8_t		num_mcs;		/* 1 to 3 MCS map pairs */
+	uint16_t	rx_mcs[3];		/* <= 80, 160, 80+80 MHz */
+	uint16_t	tx_mcs[3];
+};
+
+/* HE operation parameters */
+#define WLAN_HE_OPER_VHT_INFO		0x004000
+#define WLAN_HE_OPER_COHOSTED_BSS	0x008000
+#define WLAN_HE_OPER_6GHZ_INFO		0x020000
+
+struct uwifi_ie_he_oper {
+	uint32_t	params;			/* 24 bit */
+	uint8_t		bss_color;
+	bool		bss_color_disabled;
+	uint16_t	basic_mcs;
+	bool		has_6ghz;
+	uint8_t		primary_chan_6ghz;
+	uint8_t		width_6ghz;		/* 0: 20, 1: 40, 2: 80, 3: 160 */
+	uint8_t		center_seg0_6ghz;
+	uint8_t		center_seg1_6ghz;
+};
+
+struct uwifi_ie_eht_capab {
+	uint8_t		mac_capab[2];
+	uint8_t		phy_capab[9];
+};
+
+/* EHT operation parameters */
+#define WLAN_EHT_OPER_INFO		0x01
+#define WLAN_EHT_OPER_DISABLED_SUBCHAN	0x02
+
+struct uwifi_ie_eht_oper {
+	uint8_t		params;
+	uint32_t	basic_mcs;
+	bool		has_info;
+	uint8_t		width;			/* 0: 20 to 4: 320 MHz */
+	uint8_t		ccfs0;
+	uint8_t		ccfs1;
+	uint16_t	disabled_subchan;
+};
+
+/* one entry of the reduced neighbor report */
+struct uwifi_ie_rnr_ap {
+	uint8_t		op_class;
+	uint8_t		chan;
+	uint8_t		tbtt_offset;
+	bool		has_bssid;
+	unsigned char	bssid[WLAN_MAC_LEN];
+	bool		has_short_ssid;
+	uint32_t	short_ssid;
+	uint8_t		bss_params;
+};
+
+/* return IE with this ID (extension ID for WLAN_IE_ID_EXT) or NULL */
+const struct information_element* uwifi_ie_get(const struct uwifi_packet* p, uint8_t id);
+const struct information_element* uwifi_ie_get_ext(const struct uwifi_packet* p, uint8_t ext_id);
+
+/* return first vendor IE with this OUI and type or NULL */
+const struct information_element* uwifi_ie_get_vendor(const struct uwifi_packet* p,
+						       uint32_t oui, uint8_t type);
+
+bool uwifi_ie_rsn(const struct uwifi_packet* p, struct uwifi_ie_rsn* rsn);
+bool uwifi_ie_country(const struct uwifi_packet* p, struct uwifi_ie_country* c);
+bool uwifi_ie_bss_load(const struct uwifi_packet* p, struct uwifi_ie_bss_load* bl);
+
+/* return if bit is set in the extended capabilities */
+bool uwifi_ie_ext_capab(const struct uwifi_packet* p, unsigned int bit);
+
+bool uwifi_ie_he_capab(const struct uwifi_packet* p, struct uwifi_ie_he_capab* he);
+bool uwifi_ie_he_oper(const struct uwifi_packet* p, struct uwifi_ie_he_oper* he);
+bool uwifi_ie_eht_capab(const struct uwifi_packet* p, struct uwifi_ie_eht_capab* eht);
+bool uwifi_ie_eht_oper(const struct uwifi_packet* p, struct uwifi_ie_eht_oper* eht);
+
+/* decode up to @max neighbor APs, return number of APs stored */
+int uwifi_ie_rnr(const struct uwifi_packet* p, struct uwifi_ie_rnr_ap* aps, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
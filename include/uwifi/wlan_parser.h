@@ -28,6 +28,9 @@ extern "C" {
 #define PHY_FLAG_B		BIT(3)
 #define PHY_FLAG_G		BIT(4)
 #define PHY_FLAG_MODE_MASK	0x1C
+#define PHY_FLAG_VHT		BIT(5)
+#define PHY_FLAG_HE		BIT(6)
+#define PHY_FLAG_EHT		BIT(7)
 
 #define WLAN_MODE_AP		BIT(0)
 #define WLAN_MODE_IBSS		BIT(1)
@@ -38,17 +41,42 @@ extern "C" {
 
 #define WLAN_MODE_ALL		(WLAN_MODE_AP | WLAN_MODE_IBSS | WLAN_MODE_STA | WLAN_MODE_PROBE | WLAN_MODE_4ADDR | WLAN_MODE_UNKNOWN)
 
+struct uwifi_beacon_cache;
+
+#define UWIFI_IE_MAX		32	/* IEs indexed per packet */
+
+/* position of an IE, see wlan_ie.h for the decoders */
+struct uwifi_ie_ref {
+	uint8_t			id;
+	uint8_t			ext_id;		/* for WLAN_IE_ID_EXT, else 0 */
+	uint8_t			len;		/* without ID and length */
+	uint16_t		off;		/* from wlan_ies */
+};
+
+/* how deep uwifi_parse_raw() and uwifi_parse_80211_header() parse */
+enum uwifi_parse_level {
+	UWIFI_PARSE_PHY = 1,	/* radiotap / prism header only */
+	UWIFI_PARSE_HDR,	/* + 802.11 header and beacon fixed fields */
+	UWIFI_PARSE_FULL,	/* + information elements */
+};
+
 struct uwifi_packet {
 	/* general */
 	unsigned int		pkt_types;	/* bitmask of packet types */
+	uint64_t		pkt_ts_ns;	/* capture time on the plat_time_ns()
+						 * clock, 0 if unknown */
 
 	/* wlan phy (from radiotap) */
 	int			phy_signal;	/* signal strength (usually dBm) */		// X
 	unsigned int		phy_rate;	/* physical rate * 10 (=in 100kbps) */
-	unsigned char		phy_rate_idx;	/* MCS index */
+	unsigned char		phy_rate_idx;	/* MCS index, HT: 12 + MCS, VHT, HE
+						 * and EHT: MCS */
 	unsigned char		phy_rate_flags;	/* MCS flags */
+	unsigned char		phy_nss;	/* VHT, HE and EHT streams */
+	enum uwifi_chan_width	phy_chan_width;	/* VHT, HE and EHT PPDU width */
+	unsigned char		phy_bss_color;	/* HE and EHT BSS color, 0 unknown */
 	unsigned int		phy_freq;	/* frequency from driver */
-	unsigned int		phy_flags;	/* A, B, G, shortpre */
+	unsigned int		phy_flags;	/* PHY_FLAG_* */
 	bool			phy_injected;	/* frame was injected by ourselves */
 
 	/* wlan mac */
@@ -59,24 +87,44 @@ struct uwifi_packet {
 	unsigned char		wlan_ta[WLAN_MAC_LEN]; /* transmitter (TA) */			// X
 	unsigned char		wlan_ra[WLAN_MAC_LEN]; /* receiver (RA) */
 	unsigned char		wlan_bssid[WLAN_MAC_LEN];						// X?
-	char			wlan_essid[WLAN_MAX_SSID_LEN];
+	const char*		wlan_essid;	/* points into the frame, not NUL
+						 * terminated, NULL if no SSID */
+	unsigned char		wlan_essid_len;	/* may contain NUL */
+	uint32_t		wlan_ssid_id;	/* from uwifi_ssid_intern_packet(),
+						 * 0 if not interned */
 	uint64_t		wlan_tsf;	/* timestamp from beacon */
 	unsigned int		wlan_bintval;	/* beacon interval */
 	unsigned int		wlan_mode;	/* AP, STA or IBSS */				// X
 	unsigned char		wlan_channel;	/* channel from beacon, probe */		// X
+	unsigned char		wlan_6g_channel; /* 6GHz primary channel from HE
+						  * operation, numbers overlap
+						  * 2.4/5GHz */
 	enum uwifi_chan_width	wlan_chan_width;
 	unsigned char		wlan_tx_streams;
 	unsigned char		wlan_rx_streams;
 	unsigned char		wlan_qos_class;	/* for QDATA frames */
 	unsigned int		wlan_nav;	/* frame NAV duration */
 	unsigned int		wlan_seqno;	/* sequence number */
+	unsigned char		wlan_bss_color;	/* from HE operation IE */
+
+	/* all IEs, indexed with UWIFI_PARSE_FULL. wlan_ies points into the
+	 * frame and is only valid as long as the frame buffer. For the index
+	 * the caller has to point wlan_ie_idx to UWIFI_IE_MAX entries before
+	 * parsing, or NULL to not index. A beacon cache points it into the
+	 * cache, so it has to be set again for every packet */
+	const unsigned char*	wlan_ies;
+	struct uwifi_ie_ref*	wlan_ie_idx;
+	unsigned char		wlan_ie_num;
+	bool			wlan_ie_truncated; /* more than UWIFI_IE_MAX */
 
 	/* flags */
 	unsigned int		wlan_wep:1,	/* WEP on/off */
 				wlan_retry:1,
 				wlan_wpa:1,
 				wlan_rsn:1,
-				wlan_ht40plus:1;
+				wlan_ht40plus:1,
+				wlan_he:1,	/* HE or EHT IEs present */
+				wlan_eht:1;
 
 	/* batman-adv */
 	unsigned char		bat_version;
@@ -97,7 +145,72 @@ struct uwifi_packet {
 	int			wlan_retries;	/* retry count for this frame */
 };
 
+/*
+ * Lazy view of an 802.11 frame inside the capture buffer.
+ *
+ * uwifi_frame_view_init() only reads the frame control field and calculates
+ * the header length and the offsets of the address fields and IEs. Nothing is
+ * copied, all other values are decoded when they are accessed. The buffer has
+ * to stay valid as long as the view is used.
+ */
+struct uwifi_frame_view {
+	const unsigned char*	buf;
+	size_t			len;
+	uint16_t		fc;
+	uint8_t			hdrlen;
+	uint8_t			ra_off;		/* offsets into buf, 0 if not present */
+	uint8_t			ta_off;
+	uint8_t			bssid_off;
+	uint16_t		ie_off;		/* 0 if the frame has no IEs */
+};
+
+bool uwifi_frame_view_init(struct uwifi_frame_view* v, const unsigned char* buf, size_t len);
+unsigned int uwifi_frame_view_mode(const struct uwifi_frame_view* v);
+unsigned int uwifi_frame_view_nav(const struct uwifi_frame_view* v);
+unsigned int uwifi_frame_view_seqno(const struct uwifi_frame_view* v);
+unsigned char uwifi_frame_view_qos_class(const struct uwifi_frame_view* v);
+bool uwifi_frame_view_beacon(const struct uwifi_frame_view* v, uint64_t* tsf,
+			     unsigned int* bintval, uint16_t* capab);
+const unsigned char* uwifi_frame_view_ies(const struct uwifi_frame_view* v, size_t* len);
+const struct information_element* uwifi_frame_view_find_ie(const struct uwifi_frame_view* v, uint8_t id);
+const unsigned char* uwifi_frame_view_ssid(const struct uwifi_frame_view* v, uint8_t* len);
+
+static inline uint16_t uwifi_frame_view_type(const struct uwifi_frame_view* v)
+{
+	return v->fc & WLAN_FRAME_FC_MASK;
+}
+
+static inline const uint8_t* uwifi_frame_view_ta(const struct uwifi_frame_view* v)
+{
+	return v->ta_off ? v->buf + v->ta_off : NULL;
+}
+
+static inline const uint8_t* uwifi_frame_view_ra(const struct uwifi_frame_view* v)
+{
+	return v->ra_off ? v->buf + v->ra_off : NULL;
+}
+
+static inline const uint8_t* uwifi_frame_view_bssid(const struct uwifi_frame_view* v)
+{
+	return v->bssid_off ? v->buf + v->bssid_off : NULL;
+}
+
+static inline bool uwifi_frame_view_protected(const struct uwifi_frame_view* v)
+{
+	return v->fc & WLAN_FRAME_FC_PROTECTED;
+}
+
+static inline bool uwifi_frame_view_retry(const struct uwifi_frame_view* v)
+{
+	return v->fc & WLAN_FRAME_FC_RETRY;
+}
+
 int uwifi_parse_80211_header(unsigned char* buf, size_t len, struct uwifi_packet* p);
+int uwifi_parse_80211_header_level(unsigned char* buf, size_t len, struct uwifi_packet* p,
+				   enum uwifi_parse_level level);
+int uwifi_parse_80211_header_cached(unsigned char* buf, size_t len, struct uwifi_packet* p,
+				    enum uwifi_parse_level level,
+				    struct uwifi_beacon_cache* cache);
 uint8_t* uwifi_get_80211_header_ta(unsigned char* buf, size_t len);
 uint16_t uwifi_get_80211_header_fc(unsigned char* buf, size_t len);
 void uwifi_parse_information_elements(unsigned char* buf, size_t bufLen, struct uwifi_packet *p);
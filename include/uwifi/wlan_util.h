@@ -28,6 +28,8 @@ enum uwifi_80211_std {
 	IEEE80211_A,
 	IEEE80211_N,
 	IEEE80211_AC,
+	IEEE80211_AX,
+	IEEE80211_BE,
 };
 
 struct pkt_name {
@@ -50,12 +52,16 @@ int wlan_rate_to_index(int rate);
 int wlan_rate_to_rate(int idx);
 int wlan_ht_mcs_to_rate(int mcs, bool ht20, bool lgi);
 int wlan_vht_mcs_to_rate(enum uwifi_chan_width width, int streams, int mcs, bool sgi);
+int wlan_he_mcs_to_rate(enum uwifi_chan_width width, int streams, int mcs, int gi);
+int wlan_eht_mcs_to_rate(enum uwifi_chan_width width, int streams, int mcs, int gi);
 enum uwifi_chan_width wlan_chan_width_from_vht_capab(uint32_t vht);
 void wlan_ht_streams_from_mcs(unsigned char* mcs, unsigned char* rx, unsigned char* tx);
 void wlan_vht_streams_from_mcs(unsigned char* mcs, unsigned char* rx, unsigned char* tx);
+void wlan_he_streams_from_mcs(unsigned char* mcs, unsigned char* rx, unsigned char* tx);
 enum uwifi_80211_std wlan_80211std_from_chan(enum uwifi_chan_width width, int chan);
 enum uwifi_80211_std wlan_80211std_from_rate(int rate_idx, int chan);
 enum uwifi_80211_std wlan_80211std_from_type(uint16_t fc);
+enum uwifi_80211_std wlan_80211std_from_phy(unsigned int phy_flags);
 const char* wlan_80211std_str(enum uwifi_80211_std std);
 const char* wlan_mode_string(int mode);
 int wlan_max_phy_rate(enum uwifi_chan_width width, unsigned char streams_rx);
@@ -0,0 +1,386 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+#include <linux/filter.h>
+
+#include "bpf_filter.h"
+#include "prism_header.h"
+#include "radiotap.h"
+#include "util.h"
+#include "netdev.h"
+#include "log.h"
+
+/*
+ * Small assembler for classic BPF. Jumps go to labels which are resolved at
+ * the end, label 0 is the next instruction.
+ *
+ * Scratch memory: M[0] is the length of the PHY header (radiotap, prism) so
+ * the 802.11 header starts at [x+0] after "ldx M[0]". M[1] holds the first
+ * radiotap presence byte.
+ */
+#define BPF_MAX_LABELS	(3 * UWIFI_FILTER_MAX_MACS + 32)
+
+struct bpf_builder {
+	struct sock_filter*	prog;
+	int			num;
+	int			num_labels;
+	int			pos[BPF_MAX_LABELS];
+	uint16_t		jt[UWIFI_FILTER_MAX_INSNS];
+	uint16_t		jf[UWIFI_FILTER_MAX_INSNS];
+	bool			err;
+};
+
+static int new_label(struct bpf_builder* b)
+{
+	if (b->num_labels >= BPF_MAX_LABELS) {
+		b->err = true;
+		return 0;
+	}
+	b->pos[b->num_labels] = -1;
+	return b->num_labels++;
+}
+
+static void set_label(struct bpf_builder* b, int l)
+{
+	b->pos[l] = b->num;
+}
+
+static void jmp(struct bpf_builder* b, uint16_t code, uint32_t k, int jt, int jf)
+{
+	if (b->num >= UWIFI_FILTER_MAX_INSNS) {
+		b->err = true;
+		return;
+	}
+	b->prog[b->num].code = code;
+	b->prog[b->num].k = k;
+	b->prog[b->num].jt = 0;
+	b->prog[b->num].jf = 0;
+	b->jt[b->num] = jt;
+	b->jf[b->num] = jf;
+	b->num++;
+}
+
+static void stmt(struct bpf_builder* b, uint16_t code, uint32_t k)
+{
+	jmp(b, code, k, 0, 0);
+}
+
+static void ja(struct bpf_builder* b, int l)
+{
+	jmp(b, BPF_JMP | BPF_JA, 0, l, 0);
+}
+
+static bool resolve(struct bpf_builder* b)
+{
+	struct sock_filter* insn;
+	int i, off;
+
+	for (i = 0; i < b->num; i++) {
+		insn = &b->prog[i];
+		if (BPF_CLASS(insn->code) != BPF_JMP)
+			continue;
+
+		if (BPF_OP(insn->code) == BPF_JA) {
+			if (b->pos[b->jt[i]] < 0)
+				return false;
+			insn->k = b->pos[b->jt[i]] - (i + 1);
+			continue;
+		}
+
+		if (b->jt[i]) {
+			off = b->pos[b->jt[i]] - (i + 1);
+			if (b->pos[b->jt[i]] < 0 || off > 255)
+				return false;
+			insn->jt = off;
+		}
+		if (b->jf[i]) {
+			off = b->pos[b->jf[i]] - (i + 1);
+			if (b->pos[b->jf[i]] < 0 || off > 255)
+				return false;
+			insn->jf = off;
+		}
+	}
+	return true;
+}
+
+/* M[0] and X = length of PHY header */
+static bool emit_phy_len(struct bpf_builder* b, int arphdr)
+{
+	switch (arphdr) {
+	case ARPHRD_IEEE80211_RADIOTAP:
+		/* it_len is little endian */
+		stmt(b, BPF_LD | BPF_B | BPF_ABS, 3);
+		stmt(b, BPF_ALU | BPF_LSH | BPF_K, 8);
+		stmt(b, BPF_MISC | BPF_TAX, 0);
+		stmt(b, BPF_LD | BPF_B | BPF_ABS, 2);
+		stmt(b, BPF_ALU | BPF_OR | BPF_X, 0);
+		break;
+	case ARPHRD_IEEE80211_PRISM:
+		stmt(b, BPF_LD | BPF_IMM, sizeof(wlan_ng_prism2_header));
+		break;
+	case ARPHRD_IEEE80211:
+		stmt(b, BPF_LD | BPF_IMM, 0);
+		break;
+	default:
+		return false;
+	}
+	stmt(b, BPF_ST, 0);
+	stmt(b, BPF_MISC | BPF_TAX, 0);
+	return true;
+}
+
+/*
+ * Find the antenna signal field in the radiotap header. Only the fields of the
+ * first presence word which come before it (TSFT, flags, rate, channel, FHSS)
+ * have to be skipped. If there is no signal the frame is not filtered.
+ */
+static void emit_signal(struct bpf_builder* b, int min_signal)
+{
+	int l_words = new_label(b);
+	int l_end = new_label(b);
+	int l1 = new_label(b);
+	int l2 = new_label(b);
+	int l3 = new_label(b);
+	int l4 = new_label(b);
+	int l5 = new_label(b);
+	int i;
+
+	if (min_signal < -127)
+		min_signal = -127;
+
+	/* X = start of fields after up to 4 presence words */
+	for (i = 0; i < 4; i++) {
+		stmt(b, BPF_LDX | BPF_IMM, 8 + i * 4);
+		stmt(b, BPF_LD | BPF_B | BPF_ABS, 7 + i * 4);
+		jmp(b, BPF_JMP | BPF_JSET | BPF_K, 0x80, 0, l_words);
+	}
+	ja(b, l_end);
+
+	set_label(b, l_words);
+	stmt(b, BPF_LD | BPF_B | BPF_ABS, 4);
+	stmt(b, BPF_ST, 1);
+	jmp(b, BPF_JMP | BPF_JSET | BPF_K, BIT(IEEE80211_RADIOTAP_DBM_ANTSIGNAL), 0, l_end);
+
+	/* TSFT: 8 bytes, aligned to 8 */
+	jmp(b, BPF_JMP | BPF_JSET | BPF_K, 0x01, 0, l1);
+	stmt(b, BPF_MISC | BPF_TXA, 0);
+	stmt(b, BPF_ALU | BPF_ADD | BPF_K, 7);
+	stmt(b, BPF_ALU | BPF_AND | BPF_K, ~7U);
+	stmt(b, BPF_ALU | BPF_ADD | BPF_K, 8);
+	stmt(b, BPF_MISC | BPF_TAX, 0);
+	set_label(b, l1);
+
+	/* flags: 1 byte */
+	stmt(b, BPF_LD | BPF_MEM, 1);
+	jmp(b, BPF_JMP | BPF_JSET | BPF_K, 0x02, 0, l2);
+	stmt(b, BPF_MISC | BPF_TXA, 0);
+	stmt(b, BPF_ALU | BPF_ADD | BPF_K, 1);
+	stmt(b, BPF_MISC | BPF_TAX, 0);
+	set_label(b, l2);
+
+	/* rate: 1 byte */
+	stmt(b, BPF_LD | BPF_MEM, 1);
+	jmp(b, BPF_JMP | BPF_JSET | BPF_K, 0x04, 0, l3);
+	stmt(b, BPF_MISC | BPF_TXA, 0);
+	stmt(b, BPF_ALU | BPF_ADD | BPF_K, 1);
+	stmt(b, BPF_MISC | BPF_TAX, 0);
+	set_label(b, l3);
+
+	/* channel: 2 x 2 bytes, aligned to 2 */
+	stmt(b, BPF_LD | BPF_MEM, 1);
+	jmp(b, BPF_JMP | BPF_JSET | BPF_K, 0x08, 0, l4);
+	stmt(b, BPF_MISC | BPF_TXA, 0);
+	stmt(b, BPF_ALU | BPF_ADD | BPF_K, 1);
+	stmt(b, BPF_ALU | BPF_AND | BPF_K, ~1U);
+	stmt(b, BPF_ALU | BPF_ADD | BPF_K, 4);
+	stmt(b, BPF_MISC | BPF_TAX, 0);
+	set_label(b, l4);
+
+	/* FHSS: 2 bytes */
+	stmt(b, BPF_LD | BPF_MEM, 1);
+	jmp(b, BPF_JMP | BPF_JSET | BPF_K, 0x10, 0, l5);
+	stmt(b, BPF_MISC | BPF_TXA, 0);
+	stmt(b, BPF_ALU | BPF_ADD | BPF_K, 2);
+	stmt(b, BPF_MISC | BPF_TAX, 0);
+	set_label(b, l5);
+
+	/* signed dBm, positive values are invalid and not filtered */
+	stmt(b, BPF_LD | BPF_B | BPF_IND, 0);
+	jmp(b, BPF_JMP | BPF_JGE | BPF_K, 128, 0, l_end);
+	jmp(b, BPF_JMP | BPF_JGE | BPF_K, min_signal + 256, l_end, 0);
+	stmt(b, BPF_RET | BPF_K, 0);
+
+	set_label(b, l_end);
+	stmt(b, BPF_LDX | BPF_MEM, 0);
+}
+
+/* frame type and subtype as index into the types bitmap */
+static void emit_types(struct bpf_builder* b, uint64_t types)
+{
+	int l_hi = new_label(b);
+	int l_chk = new_label(b);
+	int l_ok = new_label(b);
+
+	stmt(b, BPF_LD | BPF_B | BPF_IND, 0);
+	stmt(b, BPF_ALU | BPF_RSH | BPF_K, 2);
+	stmt(b, BPF_ALU | BPF_AND | BPF_K, 0x3f);
+	jmp(b, BPF_JMP | BPF_JGE | BPF_K, 32, l_hi, 0);
+	stmt(b, BPF_MISC | BPF_TAX, 0);
+	stmt(b, BPF_LD | BPF_IMM, types & 0xffffffff);
+	ja(b, l_chk);
+
+	set_label(b, l_hi);
+	stmt(b, BPF_ALU | BPF_SUB | BPF_K, 32);
+	stmt(b, BPF_MISC | BPF_TAX, 0);
+	stmt(b, BPF_LD | BPF_IMM, types >> 32);
+
+	set_label(b, l_chk);
+	stmt(b, BPF_ALU | BPF_RSH | BPF_X, 0);
+	jmp(b, BPF_JMP | BPF_JSET | BPF_K, 1, l_ok, 0);
+	stmt(b, BPF_RET | BPF_K, 0);
+
+	set_label(b, l_ok);
+	stmt(b, BPF_LDX | BPF_MEM, 0);
+}
+
+/* match address at [x+off] against a set, loads are big endian */
+static void emit_macs(struct bpf_builder* b, unsigned int off,
+		      const uint8_t (*macs)[WLAN_MAC_LEN], unsigned int num)
+{
+	int l_match = new_label(b);
+	int l_next;
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		l_next = new_label(b);
+		stmt(b, BPF_LD | BPF_W | BPF_IND, off);
+		jmp(b, BPF_JMP | BPF_JEQ | BPF_K,
+		    (uint32_t)macs[i][0] << 24 | macs[i][1] << 16 | macs[i][2] << 8 | macs[i][3],
+		    0, l_next);
+		stmt(b, BPF_LD | BPF_H | BPF_IND, off + 4);
+		jmp(b, BPF_JMP | BPF_JEQ | BPF_K, macs[i][4] << 8 | macs[i][5], l_match, 0);
+		set_label(b, l_next);
+	}
+	stmt(b, BPF_RET | BPF_K, 0);
+
+	set_label(b, l_match);
+	stmt(b, BPF_LDX | BPF_MEM, 0);
+}
+
+/* X = start of BSSID, frames without BSSID are dropped */
+static void emit_bssid_offset(struct bpf_builder* b)
+{
+	int l_drop = new_label(b);
+	int l_a1 = new_label(b);
+	int l_a2 = new_label(b);
+	int l_a3 = new_label(b);
+	int l_add = new_label(b);
+
+	stmt(b, BPF_LD | BPF_B | BPF_IND, 0);
+	stmt(b, BPF_ALU | BPF_AND | BPF_K, WLAN_FRAME_FC_TYPE_MASK);
+	jmp(b, BPF_JMP | BPF_JEQ | BPF_K, WLAN_FRAME_TYPE_MGMT << 2, l_a3, 0);
+	jmp(b, BPF_JMP | BPF_JEQ | BPF_K, WLAN_FRAME_TYPE_DATA << 2, 0, l_drop);
+
+	/* data frames: depends on ToDS / FromDS */
+	stmt(b, BPF_LD | BPF_B | BPF_IND, 1);
+	stmt(b, BPF_ALU | BPF_AND | BPF_K, 0x03);
+	jmp(b, BPF_JMP | BPF_JEQ | BPF_K, 0, l_a3, 0);
+	jmp(b, BPF_JMP | BPF_JEQ | BPF_K, WLAN_FRAME_FC_TO_DS >> 8, l_a1, 0);
+	jmp(b, BPF_JMP | BPF_JEQ | BPF_K, WLAN_FRAME_FC_FROM_DS >> 8, l_a2, 0);
+	set_label(b, l_drop);
+	stmt(b, BPF_RET | BPF_K, 0);
+
+	set_label(b, l_a1);
+	stmt(b, BPF_LD | BPF_IMM, 4);
+	ja(b, l_add);
+	set_label(b, l_a2);
+	stmt(b, BPF_LD | BPF_IMM, 10);
+	ja(b, l_add);
+	set_label(b, l_a3);
+	stmt(b, BPF_LD | BPF_IMM, 16);
+	set_label(b, l_add);
+	stmt(b, BPF_ALU | BPF_ADD | BPF_X, 0);
+	stmt(b, BPF_MISC | BPF_TAX, 0);
+}
+
+int uwifi_filter_compile(const struct uwifi_filter* f, int arphdr,
+			 struct sock_filter* prog)
+{
+	struct bpf_builder b;
+
+	if (f->ta_num > UWIFI_FILTER_MAX_MACS || f->ra_num > UWIFI_FILTER_MAX_MACS ||
+	    f->bssid_num > UWIFI_FILTER_MAX_MACS)
+		return -1;
+
+	memset(&b, 0, sizeof(b));
+	b.prog = prog;
+	b.num_labels = 1; /* 0 is next instruction */
+
+	if (!emit_phy_len(&b, arphdr)) {
+		LOG_ERR("BPF: unsupported arphdr %d", arphdr);
+		return -1;
+	}
+
+	if (f->min_signal < 0 && arphdr == ARPHRD_IEEE80211_RADIOTAP)
+		emit_signal(&b, f->min_signal);
+
+	if (f->types != 0)
+		emit_types(&b, f->types);
+
+	if (f->ra_num > 0)
+		emit_macs(&b, 4, f->ra, f->ra_num);
+
+	if (f->ta_num > 0)
+		emit_macs(&b, 10, f->ta, f->ta_num);
+
+	if (f->bssid_num > 0) {
+		emit_bssid_offset(&b);
+		emit_macs(&b, 0, f->bssid, f->bssid_num);
+	}
+
+	stmt(&b, BPF_RET | BPF_K, 0xffffffff);
+
+	if (b.err || !resolve(&b)) {
+		LOG_ERR("BPF: filter too large");
+		return -1;
+	}
+	return b.num;
+}
+
+bool uwifi_filter_attach(int fd, const struct uwifi_filter* f, int arphdr)
+{
+	struct sock_filter prog[UWIFI_FILTER_MAX_INSNS];
+	struct sock_fprog fprog;
+	int num;
+
+	num = uwifi_filter_compile(f, arphdr, prog);
+	if (num < 0)
+		return false;
+
+	fprog.len = num;
+	fprog.filter = prog;
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0) {
+		LOG_ERR("BPF: could not attach filter");
+		return false;
+	}
+	return true;
+}
+
+bool uwifi_filter_detach(int fd)
+{
+	int dummy = 0;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER, &dummy, sizeof(dummy)) < 0) {
+		LOG_ERR("BPF: could not detach filter");
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,68 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_BPF_FILTER_H_
+#define _UWIFI_BPF_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wlan80211.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UWIFI_FILTER_MAX_MACS	32
+#define UWIFI_FILTER_MAX_INSNS	512
+
+/* bit for a frame type (WLAN_FRAME_BEACON, ...) in uwifi_filter.types */
+#define UWIFI_FILTER_TYPE(_t)	(1ULL << (((_t) & WLAN_FRAME_FC_MASK) >> 2))
+
+/*
+ * Frame filter which is run in the kernel. All configured conditions have to
+ * match, within an address set any address matches. Frames which don't have
+ * the address field are dropped when the set is not empty, e.g. ACK and CTS
+ * have no TA and control frames have no BSSID.
+ */
+struct uwifi_filter {
+	uint64_t	types;		/* UWIFI_FILTER_TYPE() bits, 0 for all */
+	int		min_signal;	/* dBm, 0 for no limit (radiotap only) */
+	unsigned int	ta_num;
+	unsigned int	ra_num;
+	unsigned int	bssid_num;
+	uint8_t		ta[UWIFI_FILTER_MAX_MACS][WLAN_MAC_LEN];
+	uint8_t		ra[UWIFI_FILTER_MAX_MACS][WLAN_MAC_LEN];
+	uint8_t		bssid[UWIFI_FILTER_MAX_MACS][WLAN_MAC_LEN];
+};
+
+struct sock_filter;
+
+/**
+ * uwifi_filter_compile() - generate classic BPF for a filter
+ *
+ * @f: filter description
+ * @arphdr: ARPHRD_IEEE80211_RADIOTAP, _PRISM or ARPHRD_IEEE80211
+ * @prog: output, at least UWIFI_FILTER_MAX_INSNS long
+ *
+ * Return number of instructions or -1 on error.
+ */
+int uwifi_filter_compile(const struct uwifi_filter* f, int arphdr,
+			 struct sock_filter* prog);
+
+/* compile and attach filter to a socket from packet_socket_open() */
+bool uwifi_filter_attach(int fd, const struct uwifi_filter* f, int arphdr);
+
+bool uwifi_filter_detach(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,276 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+
+#include "fanout.h"
+#include "packet_sock.h"
+#include "raw_parser.h"
+#include "essid.h"
+#include "util.h"
+#include "log.h"
+
+static void fanout_handle_packet(struct uwifi_fanout_worker* w, int channel_idx,
+				 unsigned char* buf, size_t len, uint64_t ts_ns)
+{
+	struct uwifi_fanout* fo = w->fo;
+	struct uwifi_packet p;
+	struct uwifi_ie_ref ies[UWIFI_IE_MAX];
+	struct uwifi_node* n = NULL;
+	enum uwifi_parse_level level = fo->parse_level ? fo->parse_level : UWIFI_PARSE_FULL;
+
+	memset(&p, 0, sizeof(p));
+	p.pkt_ts_ns = ts_ns;
+	if (level >= UWIFI_PARSE_FULL)
+		p.wlan_ie_idx = ies;	/* for decoders in the callback */
+	if (uwifi_parse_raw_cached(buf, len, &p, fo->intf->arphdr, level, &w->beacons) < 0)
+		return;
+
+	/* the channel list is a read-only copy, the index a snapshot */
+	uwifi_fixup_packet_channel_idx(&p, &fo->channels, channel_idx);
+
+	pthread_mutex_lock(&w->lock);
+	/* nodes need at least the 802.11 header */
+	if (level >= UWIFI_PARSE_HDR)
+		n = uwifi_node_update(&p, &w->wlan_nodes);
+	if (n != NULL) {
+		uwifi_nodes_find_ap(n, &w->wlan_nodes);
+		uwifi_essids_update(&w->essids, &p, n);
+	}
+	if (fo->cb != NULL)
+		fo->cb(w, &p, n, fo->cb_ctx);
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void fanout_count_batch(struct uwifi_fanout_worker* w,
+			       struct packet_recv_buf* bufs, int num)
+{
+	int i;
+
+	pthread_mutex_lock(&w->lock);
+	w->frames += num;
+	for (i = 0; i < num; i++)
+		w->truncated += bufs[i].truncated;
+	pthread_mutex_unlock(&w->lock);
+}
+
+static void* fanout_worker(void* arg)
+{
+	struct uwifi_fanout_worker* w = arg;
+	struct uwifi_fanout* fo = w->fo;
+	struct packet_recv_buf bufs[UWIFI_FANOUT_BATCH];
+	struct pollfd pfd;
+	int64_t ts_off;
+	int i, num, channel_idx;
+
+	for (i = 0; i < UWIFI_FANOUT_BATCH; i++) {
+		bufs[i].buf = w->buf + i * UWIFI_FANOUT_BUFSIZE;
+		bufs[i].bufsize = UWIFI_FANOUT_BUFSIZE;
+	}
+
+	pfd.fd = w->sock;
+	pfd.events = POLLIN;
+
+	while (fo->running) {
+		if (poll(&pfd, 1, 100) > 0) {
+			while ((num = packet_socket_recv_batch(w->sock, bufs,
+							       UWIFI_FANOUT_BATCH)) > 0) {
+				ts_off = packet_ts_mono_offset();
+				pthread_mutex_lock(&fo->chan_lock);
+				channel_idx = fo->channel_idx;
+				pthread_mutex_unlock(&fo->chan_lock);
+				for (i = 0; i < num; i++)
+					fanout_handle_packet(w, channel_idx, bufs[i].buf, bufs[i].len,
+						bufs[i].ts_ns ? bufs[i].ts_ns - ts_off : 0);
+				fanout_count_batch(w, bufs, num);
+			}
+		}
+
+		if (fo->node_timeout > 0) {
+			pthread_mutex_lock(&w->lock);
+			uwifi_nodes_timeout(&w->wlan_nodes, fo->node_timeout,
+					    &w->last_nodetimeout, 0);
+			pthread_mutex_unlock(&w->lock);
+		}
+	}
+
+	return NULL;
+}
+
+static void fanout_worker_free(struct uwifi_fanout_worker* w)
+{
+	if (w->sock > 0 && w->sock != w->fo->intf->sock)
+		close(w->sock);
+	w->sock = -1;
+	uwifi_essids_free(&w->essids);
+	uwifi_nodes_free(&w->wlan_nodes);
+	uwifi_ssid_table_free(&w->ssids);
+	uwifi_beacon_cache_free(&w->beacons);
+	uwifi_pool_destroy(&w->essid_pool);
+	uwifi_pool_destroy(&w->node_ext_pool);
+	uwifi_pool_destroy(&w->node_pool);
+	pthread_mutex_destroy(&w->lock);
+	free(w->buf);
+	w->buf = NULL;
+}
+
+bool uwifi_fanout_start(struct uwifi_fanout* fo, struct uwifi_interface* intf)
+{
+	int group_id;
+	int i;
+
+	if (fo->num_workers <= 0 || fo->num_workers > UWIFI_FANOUT_MAX_WORKERS) {
+		LOG_ERR("Invalid number of fanout workers %d", fo->num_workers);
+		return false;
+	}
+
+	/* group IDs are global, make it unique per process and interface */
+	group_id = (getpid() ^ (if_nametoindex(intf->ifname) << 8)) & 0xffff;
+
+	fo->intf = intf;
+	fo->running = true;
+	memcpy(&fo->channels, &intf->channels, sizeof(fo->channels));
+	pthread_mutex_init(&fo->chan_lock, NULL);
+	pthread_mutex_init(&fo->stats_lock, NULL);
+	fo->channel_idx = intf->channel_idx;
+
+	for (i = 0; i < fo->num_workers; i++) {
+		struct uwifi_fanout_worker* w = &fo->workers[i];
+		memset(w, 0, sizeof(*w));
+		w->fo = fo;
+		w->idx = i;
+		w->sock = i == 0 ? intf->sock : packet_socket_open(intf->ifname);
+		pthread_mutex_init(&w->lock, NULL);
+		uwifi_pool_init(&w->node_pool, sizeof(struct uwifi_node), 0,
+				fo->max_nodes, fo->hugepages);
+		uwifi_pool_init(&w->node_ext_pool, sizeof(struct uwifi_node_ext), 0, 0, false);
+		uwifi_pool_init(&w->essid_pool, sizeof(struct essid_info), 0, 0, false);
+		uwifi_nodes_init(&w->wlan_nodes);
+		w->wlan_nodes.pool = &w->node_pool;
+		w->wlan_nodes.ext_pool = &w->node_ext_pool;
+		uwifi_essids_init(&w->essids);
+		w->essids.pool = &w->essid_pool;
+		uwifi_ssid_table_init(&w->ssids);
+		w->essids.ssids = &w->ssids;
+		uwifi_beacon_cache_init(&w->beacons);
+		w->buf = malloc(UWIFI_FANOUT_BATCH * UWIFI_FANOUT_BUFSIZE);
+
+		/* without timestamps nodes read the clock for every frame */
+		if (w->sock >= 0)
+			packet_socket_enable_timestamps(w->sock);
+
+		if (w->sock < 0 || w->buf == NULL ||
+		    !packet_socket_set_fanout(w->sock, group_id, fo->mode) ||
+		    pthread_create(&w->thread, NULL, fanout_worker, w) != 0) {
+			LOG_ERR("Could not start fanout worker %d", i);
+			fanout_worker_free(w);
+			fo->num_workers = i;
+			uwifi_fanout_stop(fo);
+			return false;
+		}
+	}
+
+	LOG_INF("Started %d capture threads on '%s'", fo->num_workers, intf->ifname);
+	return true;
+}
+
+void uwifi_fanout_stop(struct uwifi_fanout* fo)
+{
+	int i;
+
+	fo->running = false;
+	for (i = 0; i < fo->num_workers; i++) {
+		pthread_join(fo->workers[i].thread, NULL);
+		fanout_worker_free(&fo->workers[i]);
+	}
+	fo->num_workers = 0;
+	pthread_mutex_destroy(&fo->chan_lock);
+	pthread_mutex_destroy(&fo->stats_lock);
+}
+
+void uwifi_fanout_channel_changed(struct uwifi_fanout* fo)
+{
+	pthread_mutex_lock(&fo->chan_lock);
+	fo->channel_idx = fo->intf->channel_idx;
+	pthread_mutex_unlock(&fo->chan_lock);
+}
+
+/* values which may be unknown (-1) make the sum unknown */
+static void fanout_add_unknown(int64_t* sum, int64_t v)
+{
+	if (*sum < 0 || v < 0)
+		*sum = -1;
+	else
+		*sum += v;
+}
+
+void uwifi_fanout_get_stats(struct uwifi_fanout* fo, struct uwifi_fanout_stats* st)
+{
+	int i;
+
+	memset(st, 0, sizeof(*st));
+	pthread_mutex_lock(&fo->stats_lock);
+	for (i = 0; i < fo->num_workers; i++) {
+		struct uwifi_fanout_worker* w = &fo->workers[i];
+
+		/* the syscalls must not stall the worker, which only needs its
+		 * lock for the userspace counters */
+		packet_socket_get_stats(w->sock, &w->sock_stats);
+
+		pthread_mutex_lock(&w->lock);
+		st->frames += w->frames;
+		st->truncated += w->truncated;
+		st->node_insert_fail += w->wlan_nodes.insert_fail;
+		pthread_mutex_unlock(&w->lock);
+
+		st->sock.packets += w->sock_stats.packets;
+		st->sock.drops += w->sock_stats.drops;
+		st->sock.freeze_q_cnt += w->sock_stats.freeze_q_cnt;
+		fanout_add_unknown(&st->sock.sock_drops, w->sock_stats.sock_drops);
+		fanout_add_unknown(&st->sock.rcvbuf_size, w->sock_stats.rcvbuf_size);
+		fanout_add_unknown(&st->sock.rcvbuf_used, w->sock_stats.rcvbuf_used);
+	}
+	pthread_mutex_unlock(&fo->stats_lock);
+}
+
+void uwifi_fanout_merge(struct uwifi_fanout* fo, struct uwifi_nodes* nodes,
+			struct uwifi_essids* essids)
+{
+	struct uwifi_node *n, *m;
+	int i;
+
+	for (i = 0; i < fo->num_workers; i++) {
+		struct uwifi_fanout_worker* w = &fo->workers[i];
+		pthread_mutex_lock(&w->lock);
+		/* oldest first, so the LRU list needs little sorting */
+		cc_list_for_each(&w->wlan_nodes.lru, n, lru_list) {
+			m = uwifi_node_merge(n, nodes);
+			if (m == NULL)
+				continue;
+			/* the ESSID from the most recent view wins */
+			if (n->essid != NULL &&
+			    (m->essid == NULL || m->last_seen == n->last_seen))
+				uwifi_essids_add_node_len(essids, n->essid->essid,
+							  n->essid->essid_len, m);
+		}
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	/* without holding any worker lock */
+	uwifi_nodes_sort_lru(nodes);
+
+	/* relations between nodes can only be resolved when all are known */
+	cc_list_for_each(&nodes->list, m, list)
+		uwifi_nodes_find_ap(m, nodes);
+}
@@ -0,0 +1,158 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_FANOUT_H_
+#define _UWIFI_FANOUT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "cc_list.h"
+#include "conf.h"
+#include "node.h"
+#include "essid.h"
+#include "ssid_table.h"
+#include "beacon_cache.h"
+#include "pool.h"
+#include "packet_sock.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UWIFI_FANOUT_MAX_WORKERS	16
+#define UWIFI_FANOUT_BATCH		16	/* frames per recvmmsg() */
+#define UWIFI_FANOUT_BUFSIZE		4096	/* longer frames are truncated */
+
+struct uwifi_fanout;
+struct uwifi_fanout_worker;
+
+/* called in the worker thread for every parsed packet with the worker
+ * tables locked, n is NULL if the packet did not update a node */
+typedef void (*uwifi_fanout_cb_t)(struct uwifi_fanout_worker* w,
+				  struct uwifi_packet* p,
+				  struct uwifi_node* n, void* ctx);
+
+struct uwifi_fanout_worker {
+	struct uwifi_fanout*	fo;
+	int			idx;
+	int			sock;
+	pthread_t		thread;
+	pthread_mutex_t		lock;		/* protects node and ESSID tables */
+	struct uwifi_nodes	wlan_nodes;
+	struct uwifi_essids	essids;
+	struct uwifi_pool	node_pool;
+	struct uwifi_pool	node_ext_pool;
+	struct uwifi_pool	essid_pool;
+	struct uwifi_ssid_table	ssids;		/* interns for essids */
+	struct uwifi_beacon_cache beacons;	/* only used by the worker */
+	uint64_t		last_nodetimeout;
+	unsigned char*		buf;
+
+	/* userspace counters, protected by lock */
+	uint64_t		frames;		/* received from the socket */
+	uint64_t		truncated;	/* longer than UWIFI_FANOUT_BUFSIZE */
+
+	struct packet_socket_stats sock_stats;	/* protected by fo->stats_lock */
+};
+
+struct uwifi_fanout_stats {
+	uint64_t		frames;
+	uint64_t		truncated;
+	uint64_t		node_insert_fail;	/* new transmitters which could
+							 * not be tracked */
+	struct packet_socket_stats sock;	/* sum of all worker sockets */
+};
+
+struct uwifi_fanout {
+	/* config */
+	int			mode;		/* PACKET_FANOUT_HASH, _CPU, _LB */
+	int			num_workers;
+	unsigned int		node_timeout;	/* sec, 0 to disable */
+	unsigned int		max_nodes;	/* per worker, 0 for no limit */
+	bool			hugepages;	/* for node pools */
+	enum uwifi_parse_level	parse_level;	/* 0 for UWIFI_PARSE_FULL */
+	uwifi_fanout_cb_t	cb;
+	void*			cb_ctx;
+
+	/* state */
+	struct uwifi_interface*	intf;
+	volatile bool		running;
+	struct uwifi_channels	channels;	/* copy of intf->channels */
+	pthread_mutex_t		chan_lock;	/* protects channel_idx */
+	int			channel_idx;	/* copy of intf->channel_idx */
+	pthread_mutex_t		stats_lock;	/* protects worker sock_stats */
+	struct uwifi_fanout_worker workers[UWIFI_FANOUT_MAX_WORKERS];
+};
+
+/**
+ * uwifi_fanout_start() - capture on one interface with multiple threads
+ *
+ * @fo: fanout state, mode, num_workers, node_timeout and cb have to be set
+ * @intf: interface initialized by uwifi_init(), its socket is used by the
+ *	first worker and must not be read by the application any more
+ *
+ * Opens one packet socket per worker in a PACKET_FANOUT group and starts a
+ * thread per socket. Each worker parses frames and keeps its own node and
+ * ESSID tables, allocated from per-worker pools, which can be combined with
+ * uwifi_fanout_merge().
+ *
+ * Workers never access @intf after the start, they use a copy of its channel
+ * list and current channel, which has to be updated with
+ * uwifi_fanout_channel_changed() when the application changes the channel.
+ *
+ * Note that PACKET_FANOUT_HASH uses the kernel flow hash, which does not look
+ * at 802.11 addresses, so in monitor mode PACKET_FANOUT_CPU (with RSS/RPS) or
+ * PACKET_FANOUT_LB usually spread the load better.
+ *
+ * Return true on success, false on error.
+ */
+bool uwifi_fanout_start(struct uwifi_fanout* fo, struct uwifi_interface* intf);
+
+/* stop all workers, close their sockets and free the worker tables */
+void uwifi_fanout_stop(struct uwifi_fanout* fo);
+
+/* pass the current channel of the interface to the workers, call after
+ * uwifi_channel_change() or uwifi_channel_auto_change() */
+void uwifi_fanout_channel_changed(struct uwifi_fanout* fo);
+
+/**
+ * uwifi_fanout_merge() - merge worker tables into one view
+ *
+ * @fo: fanout state
+ * @nodes: empty, initialized node table which receives copies of all nodes
+ * @essids: empty, initialized ESSID table for the merged nodes
+ *
+ * Nodes seen by several workers are combined. The result is a snapshot owned
+ * by the caller and has to be freed with uwifi_essids_free() and
+ * uwifi_nodes_free().
+ */
+void uwifi_fanout_merge(struct uwifi_fanout* fo, struct uwifi_nodes* nodes,
+			struct uwifi_essids* essids);
+
+/**
+ * uwifi_fanout_get_stats() - drop statistics of all workers
+ *
+ * @fo: fanout state
+ * @st: output, the sum of kernel socket counters and userspace counters
+ *
+ * Samples the socket statistics of each worker with
+ * packet_socket_get_stats(), without holding the worker lock, so it does not
+ * delay capture. Kernel drops mean the workers are too slow,
+ * node_insert_fail that frames were parsed but a new node could not be
+ * added, usually because max_nodes was reached.
+ */
+void uwifi_fanout_get_stats(struct uwifi_fanout* fo, struct uwifi_fanout_stats* st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,6 +26,9 @@
 #include "util.h"
 #include "netl80211.h"
 
+/* NL80211_CHAN_WIDTH_320 is missing in older kernel headers */
+#define NL80211_CHAN_WIDTH_320_	13
+
 /*
  * ifctrl interface
  */
@@ -162,6 +165,8 @@ bool ifctrl_iwset_freq(const char *const interface, unsigned int freq,
 			nl_width = NL80211_CHAN_WIDTH_160; break;
 		case CHAN_WIDTH_8080:
 			nl_width = NL80211_CHAN_WIDTH_80P80; break;
+		case CHAN_WIDTH_320:
+			nl_width = NL80211_CHAN_WIDTH_320_; break;
 	}
 
 	NLA_PUT_U32(msg, NL80211_ATTR_WIPHY_FREQ, freq);
@@ -201,6 +206,8 @@ static int nl80211_get_interface_info_cb(struct nl_msg *msg, void *arg)
 				intf->channel.width = CHAN_WIDTH_160; break;
 			case NL80211_CHAN_WIDTH_80P80:
 				intf->channel.width = CHAN_WIDTH_8080; break;
+			case NL80211_CHAN_WIDTH_320_:
+				intf->channel.width = CHAN_WIDTH_320; break;
 			default:
 				intf->channel.width = CHAN_WIDTH_UNSPEC; break;
 		}
@@ -19,9 +19,9 @@
 
 bool uwifi_init(struct uwifi_interface* intf)
 {
-	cc_list_head_init(&intf->wlan_nodes);
+	uwifi_nodes_init(&intf->wlan_nodes);
 	intf->channel_idx = -1;
-	intf->last_channelchange = plat_time_usec();
+	intf->last_channelchange = plat_time_ns();
 	intf->sock = packet_socket_open(intf->ifname);
 
 	if (intf->sock < 0) {
@@ -17,6 +17,10 @@
 extern "C" {
 #endif
 
+#ifndef ARPHRD_IEEE80211
+#define ARPHRD_IEEE80211 801            /* IEEE 802.11 */
+#endif
+
 #ifndef ARPHRD_IEEE80211_RADIOTAP
 #define ARPHRD_IEEE80211_RADIOTAP 803    /* IEEE 802.11 + radiotap header */
 #endif
@@ -7,23 +7,36 @@
  * Version 3. See the file COPYING for more details.
  */
 
+#define _GNU_SOURCE	/* for recvmmsg() */
+
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
-#include <netpacket/packet.h>
+#include <linux/if_packet.h>
+#include <linux/sock_diag.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
 #include <net/ethernet.h>
 #include <net/if.h>
 #include <arpa/inet.h>
 #include <err.h>
+#include <errno.h>
+#include <time.h>
 
 #include "packet_sock.h"
 #include "util.h"
 #include "platform.h"
 #include "log.h"
 
+#ifndef SO_MEMINFO
+#define SO_MEMINFO	55
+#endif
+
 void socket_set_receive_buffer(int fd, int sockbufsize)
 {
 	int ret;
@@ -47,6 +60,42 @@ void socket_set_receive_buffer(int fd, int sockbufsize)
 #endif
 }
 
+bool packet_socket_get_stats(int fd, struct packet_socket_stats* st)
+{
+	struct tpacket_stats_v3 tp;
+	uint32_t mem[SK_MEMINFO_VARS];
+	socklen_t len = sizeof(tp);
+	int size;
+
+	/* the kernel only fills tp_freeze_q_cnt with a TPACKET_V3 ring */
+	memset(&tp, 0, sizeof(tp));
+	if (getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &tp, &len) != 0) {
+		LOG_ERR("Could not get packet socket statistics");
+		return false;
+	}
+	st->packets += tp.tp_packets;
+	st->drops += tp.tp_drops;
+	if (len >= sizeof(tp))
+		st->freeze_q_cnt += tp.tp_freeze_q_cnt;
+
+	/* SO_MEMINFO (Linux 4.12) has the real fill level, SIOCINQ would only
+	 * return the length of the next frame on a packet socket */
+	len = sizeof(mem);
+	if (getsockopt(fd, SOL_SOCKET, SO_MEMINFO, mem, &len) == 0 &&
+	    len > SK_MEMINFO_DROPS * sizeof(uint32_t)) {
+		st->rcvbuf_size = mem[SK_MEMINFO_RCVBUF];
+		st->rcvbuf_used = mem[SK_MEMINFO_RMEM_ALLOC];
+		st->sock_drops = mem[SK_MEMINFO_DROPS];
+		return true;
+	}
+
+	len = sizeof(size);
+	st->rcvbuf_size = getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len) == 0 ? size : -1;
+	st->rcvbuf_used = -1;
+	st->sock_drops = -1;
+	return true;
+}
+
 int packet_socket_open(char* devname)
 {
 	struct sockaddr_ll sall;
@@ -74,7 +123,261 @@ int packet_socket_open(char* devname)
 	return fd;
 }
 
+bool packet_socket_set_fanout(int fd, int group_id, int mode)
+{
+	int val = (group_id & 0xffff) | (mode << 16);
+	int ret = setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &val, sizeof(val));
+	if (ret != 0) {
+		LOG_ERR("Could not join fanout group %d", group_id);
+		return false;
+	}
+	return true;
+}
+
 ssize_t packet_socket_recv(int fd, unsigned char* buffer, size_t bufsize)
 {
 	return recv(fd, buffer, bufsize, MSG_DONTWAIT);
 }
+
+bool packet_socket_enable_timestamps(int fd)
+{
+	int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+		    SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+	int on = 1;
+
+	/* hardware timestamps are only reported if the driver supports them */
+	if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+		return true;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) != 0) {
+		LOG_ERR("Could not enable socket timestamps");
+		return false;
+	}
+	return true;
+}
+
+static inline uint64_t timespec_ns(const struct timespec* ts)
+{
+	return (uint64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static void get_cmsg_timestamp(struct msghdr* msg, struct packet_recv_buf* b)
+{
+	struct cmsghdr* cmsg;
+	struct scm_timestamping tss;
+	struct timespec ts;
+
+	b->ts_ns = b->hw_ts_ns = 0;
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET)
+			continue;
+		if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+			memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+			b->ts_ns = timespec_ns(&ts);
+		} else if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+			/* ts[0] is software, ts[2] raw hardware */
+			memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+			b->ts_ns = timespec_ns(&tss.ts[0]);
+			b->hw_ts_ns = timespec_ns(&tss.ts[2]);
+		}
+	}
+}
+
+int64_t packet_ts_mono_offset(void)
+{
+	struct timespec rt, mono;
+
+	clock_gettime(CLOCK_REALTIME, &rt);
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	return (int64_t)(timespec_ns(&rt) - timespec_ns(&mono));
+}
+
+/* return number of received frames, 0 if none were pending or -1 on error */
+int packet_socket_recv_batch(int fd, struct packet_recv_buf* bufs, unsigned int num)
+{
+	struct mmsghdr msgs[PACKET_RECV_BATCH_MAX];
+	struct iovec iovs[PACKET_RECV_BATCH_MAX];
+	char ctrl[PACKET_RECV_BATCH_MAX][CMSG_SPACE(sizeof(struct scm_timestamping))];
+	unsigned int i;
+	int ret;
+
+	if (num > PACKET_RECV_BATCH_MAX)
+		num = PACKET_RECV_BATCH_MAX;
+
+	memset(msgs, 0, num * sizeof(struct mmsghdr));
+	for (i = 0; i < num; i++) {
+		iovs[i].iov_base = bufs[i].buf;
+		iovs[i].iov_len = bufs[i].bufsize;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = ctrl[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i]);
+	}
+
+	ret = recvmmsg(fd, msgs, num, MSG_DONTWAIT, NULL);
+	if (ret < 0)
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+	for (i = 0; i < (unsigned int)ret; i++) {
+		bufs[i].len = msgs[i].msg_len;
+		get_cmsg_timestamp(&msgs[i].msg_hdr, &bufs[i]);
+		bufs[i].truncated = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+	}
+	return ret;
+}
+
+/*
+ * TPACKET_V3 memory mapped RX ring
+ *
+ * The kernel fills whole blocks of frames and hands them over to userspace
+ * when a block is full or the retire timeout expired. We walk the frames of a
+ * block in place (no copy, no syscall per frame) and give the block back to the
+ * kernel when we are done with it.
+ */
+
+bool packet_ring_open(struct packet_ring* r, int fd, unsigned int block_size,
+		      unsigned int block_nr, unsigned int retire_tmo_ms)
+{
+	struct tpacket_req3 req;
+	int ver = TPACKET_V3;
+	int ret;
+
+	memset(r, 0, sizeof(struct packet_ring));
+	r->fd = -1;
+
+	if (block_size == 0)
+		block_size = PACKET_RING_BLOCK_SIZE;
+	if (block_nr == 0)
+		block_nr = PACKET_RING_BLOCK_NR;
+
+	/* blocks have to be a power of two multiple of the page size */
+	if (block_size % getpagesize() != 0 ||
+	    !is_power_of_2(block_size / getpagesize())) {
+		LOG_ERR("Invalid ring block size %u", block_size);
+		return false;
+	}
+
+	ret = setsockopt(fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver));
+	if (ret != 0) {
+		LOG_ERR("TPACKET_V3 not supported");
+		return false;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = block_size;
+	req.tp_block_nr = block_nr;
+	req.tp_frame_size = PACKET_RING_FRAME_SIZE;
+	req.tp_frame_nr = (block_size * block_nr) / PACKET_RING_FRAME_SIZE;
+	req.tp_retire_blk_tov = retire_tmo_ms;
+	req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+
+	ret = setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+	if (ret != 0) {
+		LOG_ERR("Could not set up RX ring (%u blocks of %u bytes)",
+			block_nr, block_size);
+		return false;
+	}
+
+	r->map_len = (size_t)block_size * block_nr;
+	r->map = mmap(NULL, r->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (r->map == MAP_FAILED) {
+		LOG_ERR("Could not mmap RX ring");
+		r->map = NULL;
+		/* tear down ring in kernel so recv() works again */
+		memset(&req, 0, sizeof(req));
+		setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+		return false;
+	}
+
+	r->fd = fd;
+	r->block_size = block_size;
+	r->block_nr = block_nr;
+	LOG_DBG("RX ring %u blocks of %u bytes, timeout %ums",
+		block_nr, block_size, retire_tmo_ms);
+	return true;
+}
+
+void packet_ring_close(struct packet_ring* r)
+{
+	struct tpacket_req3 req;
+
+	if (r->map == NULL)
+		return;
+
+	munmap(r->map, r->map_len);
+	r->map = NULL;
+
+	/* tear down ring in kernel, the socket stays usable for recv() */
+	memset(&req, 0, sizeof(req));
+	setsockopt(r->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+	r->block = NULL;
+	r->fd = -1;
+}
+
+/** return true if the next block is ready for userspace */
+bool packet_ring_block_get(struct packet_ring* r)
+{
+	struct tpacket_block_desc* bd;
+
+	if (r->block != NULL)
+		return true;
+
+	bd = (struct tpacket_block_desc*)(r->map + (size_t)r->block_idx * r->block_size);
+	if ((__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0)
+		return false;
+
+	r->block = bd;
+	r->frame = (struct tpacket3_hdr*)((uint8_t*)bd + bd->hdr.bh1.offset_to_first_pkt);
+	r->frames_left = bd->hdr.bh1.num_pkts;
+	return true;
+}
+
+/** wait up to timeout_ms for the next block, return true if one is ready */
+bool packet_ring_block_wait(struct packet_ring* r, int timeout_ms)
+{
+	struct pollfd pfd;
+
+	if (packet_ring_block_get(r))
+		return true;
+
+	pfd.fd = r->fd;
+	pfd.events = POLLIN | POLLERR;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, timeout_ms) <= 0)
+		return false;
+
+	return packet_ring_block_get(r);
+}
+
+/** get next frame of current block, return false when block is done */
+bool packet_ring_frame_next(struct packet_ring* r, struct packet_ring_frame* f)
+{
+	struct tpacket3_hdr* h = r->frame;
+
+	if (r->block == NULL || r->frames_left == 0)
+		return false;
+
+	f->buf = (unsigned char*)h + h->tp_mac;
+	f->len = h->tp_snaplen;
+	f->orig_len = h->tp_len;
+	f->status = h->tp_status;
+	f->ts_ns = (uint64_t)h->tp_sec * 1000000000 + h->tp_nsec;
+	f->hw_ts = (h->tp_status & TP_STATUS_TS_RAW_HARDWARE) != 0;
+
+	r->frame = (struct tpacket3_hdr*)((uint8_t*)h + h->tp_next_offset);
+	r->frames_left--;
+	return true;
+}
+
+/** hand current block back to the kernel and advance to the next one */
+void packet_ring_block_put(struct packet_ring* r)
+{
+	if (r->block == NULL)
+		return;
+
+	__atomic_store_n(&r->block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+	r->block = NULL;
+	r->frame = NULL;
+	r->frames_left = 0;
+	r->block_idx = (r->block_idx + 1) % r->block_nr;
+}
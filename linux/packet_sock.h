@@ -11,6 +11,9 @@
 #define _UWIFI_PKT_SOCKET_H_
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,10 +21,135 @@ extern "C" {
 
 int packet_socket_open(char* devname);
 
+/* join fanout group, mode is PACKET_FANOUT_HASH, PACKET_FANOUT_CPU, ... */
+bool packet_socket_set_fanout(int fd, int group_id, int mode);
+
 ssize_t packet_socket_recv(int fd, unsigned char* buffer, size_t bufsize);
 
+#define PACKET_RECV_BATCH_MAX		64
+
+struct packet_recv_buf {
+	unsigned char*		buf;		/* provided by caller */
+	size_t			bufsize;	/* provided by caller */
+	size_t			len;		/* received length */
+	uint64_t		ts_ns;		/* kernel timestamp (CLOCK_REALTIME) or 0 */
+	uint64_t		hw_ts_ns;	/* raw hardware timestamp or 0 */
+	bool			truncated;	/* frame was longer than bufsize */
+};
+
+/**
+ * packet_socket_recv_batch() - receive multiple frames with one syscall
+ *
+ * @fd: packet socket
+ * @bufs: array of buffers, buf and bufsize have to be set by the caller
+ * @num: number of buffers, at most PACKET_RECV_BATCH_MAX are used
+ *
+ * Kernel timestamps are only reported after packet_socket_enable_timestamps(),
+ * hardware timestamps only if the driver supports them. Does not block.
+ * Return number of frames received, 0 if nothing was pending or -1 on error.
+ */
+int packet_socket_recv_batch(int fd, struct packet_recv_buf* bufs, unsigned int num);
+
+/* enable SO_TIMESTAMPING (software and hardware) or SO_TIMESTAMPNS */
+bool packet_socket_enable_timestamps(int fd);
+
+/* kernel timestamps are CLOCK_REALTIME, subtract this offset to get
+ * CLOCK_MONOTONIC like plat_time_ns(). Sample once per batch or block */
+int64_t packet_ts_mono_offset(void);
+
 void socket_set_receive_buffer(int fd, int sockbufsize);
 
+/* kernel counters of a packet socket, accumulated over calls */
+struct packet_socket_stats {
+	uint64_t		packets;	/* seen by the socket, including drops */
+	uint64_t		drops;		/* dropped, socket buffer or ring full */
+	uint64_t		freeze_q_cnt;	/* TPACKET_V3 ring: times the queue
+						 * was frozen because no block was free */
+	int64_t			sock_drops;	/* all drops of the socket, -1 if unknown */
+	int64_t			rcvbuf_size;	/* SO_RCVBUF, -1 if unknown */
+	int64_t			rcvbuf_used;	/* bytes queued, -1 if unknown */
+};
+
+/**
+ * packet_socket_get_stats() - sample drop counters and receive buffer fill
+ *
+ * @fd: packet socket, with or without RX ring
+ * @st: zeroed before the first call, the PACKET_STATISTICS counters are
+ *	reset in the kernel on every read and are added to it
+ *
+ * Costs two getsockopt() calls, so it can be called once per second or so
+ * from a timer. Return true on success, false on error.
+ */
+bool packet_socket_get_stats(int fd, struct packet_socket_stats* st);
+
+/* TPACKET_V3 RX ring defaults: 16 blocks of 256kB (4MB locked memory per
+ * socket), frame size is only a hint */
+#define PACKET_RING_BLOCK_SIZE		(1 << 18)
+#define PACKET_RING_BLOCK_NR		16
+#define PACKET_RING_FRAME_SIZE		2048
+#define PACKET_RING_RETIRE_TMO		60	/* ms */
+
+struct tpacket_block_desc;
+struct tpacket3_hdr;
+
+struct packet_ring {
+	int			fd;
+	unsigned char*		map;
+	size_t			map_len;
+	unsigned int		block_size;
+	unsigned int		block_nr;
+	unsigned int		block_idx;	/* next block to read */
+	struct tpacket_block_desc* block;	/* block owned by us or NULL */
+	struct tpacket3_hdr*	frame;		/* next frame in block */
+	unsigned int		frames_left;
+};
+
+/* frame in the ring, buf points directly into the mapped block */
+struct packet_ring_frame {
+	unsigned char*		buf;
+	size_t			len;		/* captured length */
+	size_t			orig_len;	/* original length */
+	uint32_t		status;		/* tp_status (TP_STATUS_*) */
+	uint64_t		ts_ns;		/* kernel timestamp (CLOCK_REALTIME) */
+	bool			hw_ts;		/* ts_ns is a raw hardware timestamp */
+};
+
+/**
+ * packet_ring_open() - set up a TPACKET_V3 RX ring on a packet socket
+ *
+ * @r: ring state
+ * @fd: socket from packet_socket_open()
+ * @block_size: size of one block, a power of two multiple of the page size
+ *	(0 for PACKET_RING_BLOCK_SIZE)
+ * @block_nr: number of blocks (0 for PACKET_RING_BLOCK_NR)
+ * @retire_tmo_ms: time after which a partially filled block is handed to
+ *	userspace (0 lets the kernel choose). Larger values mean more frames
+ *	per block at the cost of latency.
+ *
+ * Typical usage:
+ *
+ *	if (packet_ring_block_wait(&ring, 100)) {
+ *		while (packet_ring_frame_next(&ring, &f))
+ *			uwifi_parse_raw(f.buf, f.len, &p, arphdr);
+ *		packet_ring_block_put(&ring);
+ *	}
+ *
+ * Frame buffers are only valid until packet_ring_block_put() is called.
+ * Return true on success, false on error.
+ */
+bool packet_ring_open(struct packet_ring* r, int fd, unsigned int block_size,
+		      unsigned int block_nr, unsigned int retire_tmo_ms);
+
+void packet_ring_close(struct packet_ring* r);
+
+bool packet_ring_block_get(struct packet_ring* r);
+
+bool packet_ring_block_wait(struct packet_ring* r, int timeout_ms);
+
+bool packet_ring_frame_next(struct packet_ring* r, struct packet_ring_frame* f);
+
+void packet_ring_block_put(struct packet_ring* r);
+
 #ifdef __cplusplus
 }
 #endif
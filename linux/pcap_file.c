@@ -0,0 +1,637 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#define _GNU_SOURCE	/* for O_DIRECT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <byteswap.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "pcap_file.h"
+#include "raw_parser.h"
+#include "netdev.h"
+#include "node.h"
+#include "essid.h"
+#include "beacon_cache.h"
+#include "channel.h"
+#include "wlan_util.h"
+#include "log.h"
+
+#define PCAP_MAGIC		0xa1b2c3d4
+#define PCAP_MAGIC_NSEC		0xa1b23c4d
+#define PCAP_HDR_LEN		24
+#define PCAP_REC_HDR_LEN	16
+
+#define PCAPNG_BLOCK_SHB	0x0a0d0d0a
+#define PCAPNG_BLOCK_IDB	0x00000001
+#define PCAPNG_BLOCK_SPB	0x00000003
+#define PCAPNG_BLOCK_EPB	0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC	0x1a2b3c4d
+#define PCAPNG_OPT_END		0
+#define PCAPNG_OPT_IF_NAME	2
+#define PCAPNG_OPT_IF_DESC	3
+#define PCAPNG_OPT_IF_TSRESOL	9
+
+#define PCAP_WRITE_ALIGN	4096
+#define PCAP_WRITE_SNAPLEN	65535
+
+static inline uint16_t rd16(const struct uwifi_pcap_file* pf, const unsigned char* b)
+{
+	uint16_t v;
+	memcpy(&v, b, 2);
+	return pf->swapped ? bswap_16(v) : v;
+}
+
+static inline uint32_t rd32(const struct uwifi_pcap_file* pf, const unsigned char* b)
+{
+	uint32_t v;
+	memcpy(&v, b, 4);
+	return pf->swapped ? bswap_32(v) : v;
+}
+
+static int linktype_to_arphdr(unsigned int linktype)
+{
+	switch (linktype) {
+	case LINKTYPE_IEEE802_11:		return ARPHRD_IEEE80211;
+	case LINKTYPE_IEEE802_11_PRISM:		return ARPHRD_IEEE80211_PRISM;
+	case LINKTYPE_IEEE802_11_RADIOTAP:	return ARPHRD_IEEE80211_RADIOTAP;
+	}
+	return -1;
+}
+
+static unsigned int arphdr_to_linktype(int arphdr)
+{
+	switch (arphdr) {
+	case ARPHRD_IEEE80211:			return LINKTYPE_IEEE802_11;
+	case ARPHRD_IEEE80211_PRISM:		return LINKTYPE_IEEE802_11_PRISM;
+	case ARPHRD_IEEE80211_RADIOTAP:		return LINKTYPE_IEEE802_11_RADIOTAP;
+	}
+	return 0;
+}
+
+/* pcapng if_tsresol: power of 10 or, if the MSB is set, power of 2 */
+static uint64_t ts_to_ns(uint64_t ts, uint8_t tsresol)
+{
+	unsigned int e = tsresol & 0x7f;
+	uint64_t m = 1;
+
+	if (tsresol & 0x80) {
+		if (e >= 64)
+			return 0;
+		if (e > 30) { /* avoid overflow below */
+			ts >>= e - 30;
+			e = 30;
+		}
+		return (ts >> e) * 1000000000ULL +
+			(((ts & ((1ULL << e) - 1)) * 1000000000ULL) >> e);
+	}
+
+	if (e <= 9) {
+		for (; e < 9; e++)
+			m *= 10;
+		return ts * m;
+	}
+	for (; e > 9 && m < 1000000000000000000ULL; e--)
+		m *= 10;
+	return ts / m;
+}
+
+static bool pcap_parse_header(struct uwifi_pcap_file* pf)
+{
+	uint32_t magic;
+	int arphdr;
+
+	if (pf->map_len < PCAP_HDR_LEN)
+		return false;
+
+	memcpy(&magic, pf->map, 4);
+	if (magic == bswap_32(PCAP_MAGIC) || magic == bswap_32(PCAP_MAGIC_NSEC)) {
+		pf->swapped = true;
+		magic = bswap_32(magic);
+	}
+	if (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NSEC)
+		return false;
+	pf->nsec = (magic == PCAP_MAGIC_NSEC);
+
+	arphdr = linktype_to_arphdr(rd32(pf, pf->map + 20));
+	if (arphdr < 0) {
+		LOG_ERR("PCAP: unsupported link type %u", rd32(pf, pf->map + 20));
+		return false;
+	}
+
+	pf->ifs[0].arphdr = arphdr;
+	pf->if_num = 1;
+	pf->start = PCAP_HDR_LEN;
+	return true;
+}
+
+static int pcap_next(struct uwifi_pcap_file* pf, struct uwifi_pcap_frame* f)
+{
+	unsigned char* b = pf->map + pf->pos;
+	uint32_t caplen, frac;
+
+	if (pf->pos == pf->map_len)
+		return 0;
+	if (pf->map_len - pf->pos < PCAP_REC_HDR_LEN)
+		return -1;
+
+	caplen = rd32(pf, b + 8);
+	if (caplen > pf->map_len - pf->pos - PCAP_REC_HDR_LEN)
+		return -1;
+
+	frac = rd32(pf, b + 4);
+	f->ts_ns = (uint64_t)rd32(pf, b) * 1000000000ULL +
+		   (pf->nsec ? frac : (uint64_t)frac * 1000);
+	f->buf = b + PCAP_REC_HDR_LEN;
+	f->len = caplen;
+	f->orig_len = rd32(pf, b + 12);
+	f->arphdr = pf->ifs[0].arphdr;
+
+	pf->pos += PCAP_REC_HDR_LEN + caplen;
+	return 1;
+}
+
+static void pcapng_parse_idb(struct uwifi_pcap_file* pf, unsigned char* b, uint32_t blen)
+{
+	struct uwifi_pcap_if* pif;
+	unsigned char* opt = b + 16;
+	unsigned char* end = b + blen - 4;
+	uint16_t code, len;
+
+	if (pf->if_num >= UWIFI_PCAP_MAX_IF) {
+		pf->if_num++;
+		return;
+	}
+
+	/* too short for a link type, frames on it are skipped */
+	if (blen < 20) {
+		pf->ifs[pf->if_num++].arphdr = -1;
+		return;
+	}
+
+	pif = &pf->ifs[pf->if_num++];
+	pif->arphdr = linktype_to_arphdr(rd16(pf, b + 8));
+	pif->tsresol = 6;
+
+	while (opt + 4 <= end) {
+		code = rd16(pf, opt);
+		len = rd16(pf, opt + 2);
+		if (code == PCAPNG_OPT_END || opt + 4 + len > end)
+			break;
+		if (code == PCAPNG_OPT_IF_TSRESOL && len >= 1)
+			pif->tsresol = opt[4];
+		opt += 4 + ((len + 3) & ~3);
+	}
+}
+
+static int pcapng_next(struct uwifi_pcap_file* pf, struct uwifi_pcap_frame* f)
+{
+	unsigned char* b;
+	uint32_t type, blen, if_id, caplen;
+	uint32_t bom;
+
+	while (pf->pos < pf->map_len) {
+		if (pf->map_len - pf->pos < 12)
+			return -1;
+
+		b = pf->map + pf->pos;
+		memcpy(&type, b, 4);
+
+		/* each section can have its own byte order */
+		if (type == PCAPNG_BLOCK_SHB) {
+			if (pf->map_len - pf->pos < 28)
+				return -1;
+			memcpy(&bom, b + 8, 4);
+			if (bom == PCAPNG_BYTE_ORDER_MAGIC)
+				pf->swapped = false;
+			else if (bom == bswap_32(PCAPNG_BYTE_ORDER_MAGIC))
+				pf->swapped = true;
+			else
+				return -1;
+			pf->if_num = 0;
+		}
+
+		type = rd32(pf, b);
+		blen = rd32(pf, b + 4);
+		if (blen < 12 || (blen & 3) || blen > pf->map_len - pf->pos)
+			return -1;
+
+		pf->pos += blen;
+
+		switch (type) {
+		case PCAPNG_BLOCK_IDB:
+			pcapng_parse_idb(pf, b, blen);
+			break;
+
+		case PCAPNG_BLOCK_EPB:
+			if (blen < 32)
+				return -1;
+			if_id = rd32(pf, b + 8);
+			caplen = rd32(pf, b + 20);
+			if (caplen > blen - 32)
+				return -1;
+			if (if_id >= pf->if_num || if_id >= UWIFI_PCAP_MAX_IF ||
+			    pf->ifs[if_id].arphdr < 0)
+				break;
+			f->buf = b + 28;
+			f->len = caplen;
+			f->orig_len = rd32(pf, b + 24);
+			f->ts_ns = ts_to_ns(((uint64_t)rd32(pf, b + 12) << 32) | rd32(pf, b + 16),
+					    pf->ifs[if_id].tsresol);
+			f->arphdr = pf->ifs[if_id].arphdr;
+			return 1;
+
+		case PCAPNG_BLOCK_SPB:
+			if (blen < 16)
+				return -1;
+			if (pf->if_num == 0 || pf->ifs[0].arphdr < 0)
+				break;
+			f->buf = b + 12;
+			f->orig_len = rd32(pf, b + 8);
+			f->len = f->orig_len < blen - 16 ? f->orig_len : blen - 16;
+			f->ts_ns = 0;
+			f->arphdr = pf->ifs[0].arphdr;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+bool uwifi_pcap_open(struct uwifi_pcap_file* pf, const char* filename)
+{
+	struct stat st;
+	uint32_t magic;
+	int fd;
+
+	memset(pf, 0, sizeof(*pf));
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		LOG_ERR("PCAP: could not open %s (%s)", filename, strerror(errno));
+		return false;
+	}
+
+	if (fstat(fd, &st) < 0 || st.st_size < 4) {
+		LOG_ERR("PCAP: %s is empty or unreadable", filename);
+		close(fd);
+		return false;
+	}
+
+	/* private writable mapping so frames can be handed to the parsers
+	 * like socket buffers, pages are only copied if they are written */
+	pf->map_len = st.st_size;
+	pf->map = mmap(NULL, pf->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (pf->map == MAP_FAILED) {
+		LOG_ERR("PCAP: mmap failed (%s)", strerror(errno));
+		pf->map = NULL;
+		return false;
+	}
+	madvise(pf->map, pf->map_len, MADV_SEQUENTIAL);
+
+	memcpy(&magic, pf->map, 4);
+	if (magic == PCAPNG_BLOCK_SHB) {
+		pf->ng = true;
+		pf->start = 0;
+	} else if (!pcap_parse_header(pf)) {
+		LOG_ERR("PCAP: %s is not a supported pcap or pcapng file", filename);
+		uwifi_pcap_close(pf);
+		return false;
+	}
+
+	pf->pos = pf->start;
+	return true;
+}
+
+int uwifi_pcap_next(struct uwifi_pcap_file* pf, struct uwifi_pcap_frame* f)
+{
+	if (pf->ng)
+		return pcapng_next(pf, f);
+	return pcap_next(pf, f);
+}
+
+void uwifi_pcap_rewind(struct uwifi_pcap_file* pf)
+{
+	pf->pos = pf->start;
+	if (pf->ng)
+		pf->if_num = 0;
+}
+
+void uwifi_pcap_close(struct uwifi_pcap_file* pf)
+{
+	if (pf->map != NULL)
+		munmap(pf->map, pf->map_len);
+	pf->map = NULL;
+	pf->map_len = 0;
+}
+
+int uwifi_pcap_replay(struct uwifi_pcap_file* pf, struct uwifi_nodes* nodes,
+		      struct uwifi_essids* essids, enum uwifi_parse_level level,
+		      unsigned int timeout_sec)
+{
+	struct uwifi_pcap_frame f;
+	struct uwifi_packet p;
+	struct uwifi_ie_ref ies[UWIFI_IE_MAX];
+	struct uwifi_channels channels;
+	struct uwifi_beacon_cache beacons;
+	struct uwifi_node* n;
+	uint64_t now = 0, last_timeout = 0;
+	int num = 0;
+	int ret;
+
+	memset(&channels, 0, sizeof(channels));
+	uwifi_beacon_cache_init(&beacons);
+
+	while ((ret = uwifi_pcap_next(pf, &f)) > 0) {
+		num++;
+		/* frames without timestamp (pcapng SPB) get the previous one */
+		if (f.ts_ns)
+			now = f.ts_ns;
+
+		memset(&p, 0, sizeof(p));
+		p.pkt_ts_ns = now;
+		if (level >= UWIFI_PARSE_FULL)
+			p.wlan_ie_idx = ies;
+		if (uwifi_parse_raw_cached(f.buf, f.len, &p, f.arphdr, level, &beacons) < 0)
+			continue;
+
+		/* channels are not known from a file, add them as they are seen */
+		if (p.phy_freq && uwifi_channel_idx_from_freq(&channels, p.phy_freq) < 0)
+			uwifi_channel_list_add(&channels, p.phy_freq);
+		uwifi_fixup_packet_channel_idx(&p, &channels, -1);
+
+		if (level >= UWIFI_PARSE_HDR) {
+			n = uwifi_node_update(&p, nodes);
+			if (n != NULL) {
+				uwifi_nodes_find_ap(n, nodes);
+				if (essids != NULL)
+					uwifi_essids_update(essids, &p, n);
+			}
+		}
+
+		if (timeout_sec > 0 && now != 0)
+			uwifi_nodes_timeout(nodes, timeout_sec, &last_timeout, now);
+	}
+
+	uwifi_beacon_cache_free(&beacons);
+	return ret < 0 ? -1 : num;
+}
+
+/*
+ * pcapng writer
+ */
+
+static bool write_iov(int fd, struct iovec* iov, int cnt)
+{
+	ssize_t ret;
+
+	while (cnt > 0) {
+		ret = writev(fd, iov, cnt);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			LOG_ERR("PCAP: write failed (%s)", strerror(errno));
+			return false;
+		}
+		while (cnt > 0 && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+		if (cnt > 0) {
+			iov->iov_base = (unsigned char*)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+	return true;
+}
+
+/* with O_DIRECT write only whole pages and keep the rest in the buffer */
+static bool writer_flush_buf(struct uwifi_pcap_writer* w, bool all)
+{
+	struct iovec iov;
+	size_t n = w->len;
+
+	if (w->direct && !all)
+		n &= ~(size_t)(PCAP_WRITE_ALIGN - 1);
+	if (n == 0)
+		return true;
+
+	iov.iov_base = w->buf;
+	iov.iov_len = n;
+	if (!write_iov(w->fd, &iov, 1))
+		return false;
+
+	w->len -= n;
+	if (w->len > 0)
+		memmove(w->buf, w->buf + n, w->len);
+	return true;
+}
+
+/* append block consisting of @hdr, @data, padding and the trailing length */
+static bool writer_block(struct uwifi_pcap_writer* w, const void* hdr, size_t hlen,
+			 const void* data, size_t dlen)
+{
+	unsigned char trailer[8] = { 0 };
+	size_t pad = (4 - ((hlen + dlen) & 3)) & 3;
+	uint32_t blen = hlen + dlen + pad + 4;
+	struct iovec iov[4];
+
+	memcpy(trailer + pad, &blen, 4);
+
+	if (w->len + blen > w->bufsize) {
+		if (!w->direct) {
+			/* write out buffer and this block in one go */
+			iov[0].iov_base = w->buf;
+			iov[0].iov_len = w->len;
+			iov[1].iov_base = (void*)hdr;
+			iov[1].iov_len = hlen;
+			iov[2].iov_base = (void*)data;
+			iov[2].iov_len = dlen;
+			iov[3].iov_base = trailer;
+			iov[3].iov_len = pad + 4;
+			w->len = 0;
+			return write_iov(w->fd, iov, 4);
+		}
+		/* at most one page remains, the block is smaller than that
+		 * because bufsize is at least UWIFI_PCAP_WRITE_BUFSIZE_MIN */
+		if (!writer_flush_buf(w, false))
+			return false;
+	}
+
+	memcpy(w->buf + w->len, hdr, hlen);
+	if (dlen > 0)
+		memcpy(w->buf + w->len + hlen, data, dlen);
+	memcpy(w->buf + w->len + hlen + dlen, trailer, pad + 4);
+	w->len += blen;
+	return true;
+}
+
+static size_t put_option(unsigned char* buf, uint16_t code, const void* val, uint16_t len)
+{
+	memcpy(buf, &code, 2);
+	memcpy(buf + 2, &len, 2);
+	memcpy(buf + 4, val, len);
+	memset(buf + 4 + len, 0, (4 - (len & 3)) & 3);
+	return 4 + ((len + 3) & ~3);
+}
+
+bool uwifi_pcap_writer_open(struct uwifi_pcap_writer* w, const char* filename,
+			    size_t bufsize, bool direct)
+{
+	unsigned char shb[24];
+	uint32_t u32;
+	uint16_t u16;
+	int64_t section_len = -1;
+	void* buf;
+
+	memset(w, 0, sizeof(*w));
+	w->fd = -1;
+
+	if (bufsize == 0)
+		bufsize = UWIFI_PCAP_WRITE_BUFSIZE;
+	else if (bufsize < UWIFI_PCAP_WRITE_BUFSIZE_MIN)
+		bufsize = UWIFI_PCAP_WRITE_BUFSIZE_MIN;
+	bufsize = (bufsize + PCAP_WRITE_ALIGN - 1) & ~(size_t)(PCAP_WRITE_ALIGN - 1);
+
+	if (posix_memalign(&buf, PCAP_WRITE_ALIGN, bufsize) != 0) {
+		LOG_ERR("PCAP: could not allocate write buffer");
+		return false;
+	}
+
+	w->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0644);
+	if (w->fd < 0 && direct && errno == EINVAL) {
+		LOG_INF("PCAP: O_DIRECT not supported for %s", filename);
+		direct = false;
+		w->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+	if (w->fd < 0) {
+		LOG_ERR("PCAP: could not create %s (%s)", filename, strerror(errno));
+		free(buf);
+		return false;
+	}
+
+	w->buf = buf;
+	w->bufsize = bufsize;
+	w->direct = direct;
+
+	u32 = PCAPNG_BLOCK_SHB;
+	memcpy(shb, &u32, 4);
+	u32 = 28;
+	memcpy(shb + 4, &u32, 4);
+	u32 = PCAPNG_BYTE_ORDER_MAGIC;
+	memcpy(shb + 8, &u32, 4);
+	u16 = 1;
+	memcpy(shb + 12, &u16, 2);	/* version 1.0 */
+	u16 = 0;
+	memcpy(shb + 14, &u16, 2);
+	memcpy(shb + 16, &section_len, 8);
+
+	return writer_block(w, shb, sizeof(shb), NULL, 0);
+}
+
+int uwifi_pcap_writer_add_if(struct uwifi_pcap_writer* w, int arphdr,
+			     const char* name, unsigned int freq)
+{
+	unsigned char idb[256];
+	char desc[64];
+	unsigned int linktype = arphdr_to_linktype(arphdr);
+	uint8_t tsresol = 9;	/* nanoseconds */
+	uint32_t u32;
+	uint16_t u16;
+	size_t len = 16;
+
+	if (linktype == 0) {
+		LOG_ERR("PCAP: unsupported arphdr %d", arphdr);
+		return -1;
+	}
+
+	u32 = PCAPNG_BLOCK_IDB;
+	memcpy(idb, &u32, 4);
+	u16 = linktype;
+	memcpy(idb + 8, &u16, 2);
+	u16 = 0;
+	memcpy(idb + 10, &u16, 2);
+	u32 = PCAP_WRITE_SNAPLEN;
+	memcpy(idb + 12, &u32, 4);
+
+	if (name != NULL)
+		len += put_option(idb + len, PCAPNG_OPT_IF_NAME, name,
+				  strnlen(name, sizeof(desc) - 1));
+	if (freq > 0) {
+		snprintf(desc, sizeof(desc), "channel %d (%u MHz)", wlan_freq2chan(freq), freq);
+		len += put_option(idb + len, PCAPNG_OPT_IF_DESC, desc, strlen(desc));
+	}
+	len += put_option(idb + len, PCAPNG_OPT_IF_TSRESOL, &tsresol, 1);
+	len += put_option(idb + len, PCAPNG_OPT_END, NULL, 0);
+
+	u32 = len + 4;
+	memcpy(idb + 4, &u32, 4);
+
+	if (!writer_block(w, idb, len, NULL, 0))
+		return -1;
+	return w->if_num++;
+}
+
+bool uwifi_pcap_write(struct uwifi_pcap_writer* w, int if_id, const unsigned char* buf,
+		      size_t len, size_t orig_len, uint64_t ts_ns)
+{
+	uint32_t epb[7];
+
+	if (if_id < 0 || (unsigned int)if_id >= w->if_num)
+		return false;
+
+	if (orig_len == 0)
+		orig_len = len;
+	if (len > PCAP_WRITE_SNAPLEN)
+		len = PCAP_WRITE_SNAPLEN;
+
+	epb[0] = PCAPNG_BLOCK_EPB;
+	epb[1] = 32 + ((len + 3) & ~3);
+	epb[2] = if_id;
+	epb[3] = ts_ns >> 32;
+	epb[4] = ts_ns & 0xffffffff;
+	epb[5] = len;
+	epb[6] = orig_len;
+
+	return writer_block(w, epb, sizeof(epb), buf, len);
+}
+
+bool uwifi_pcap_writer_flush(struct uwifi_pcap_writer* w)
+{
+	return writer_flush_buf(w, false);
+}
+
+bool uwifi_pcap_writer_close(struct uwifi_pcap_writer* w)
+{
+	bool ret = true;
+
+	if (w->fd < 0)
+		return false;
+
+	if (w->direct) {
+		ret = writer_flush_buf(w, false);
+		/* the tail is not page sized, write it without O_DIRECT */
+		fcntl(w->fd, F_SETFL, fcntl(w->fd, F_GETFL) & ~O_DIRECT);
+	}
+	ret = writer_flush_buf(w, true) && ret;
+
+	close(w->fd);
+	free(w->buf);
+	w->fd = -1;
+	w->buf = NULL;
+	return ret;
+}
@@ -0,0 +1,144 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#ifndef _UWIFI_PCAP_FILE_H_
+#define _UWIFI_PCAP_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wlan_parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* link types we can parse */
+#define LINKTYPE_IEEE802_11		105
+#define LINKTYPE_IEEE802_11_PRISM	119
+#define LINKTYPE_IEEE802_11_RADIOTAP	127
+
+#define UWIFI_PCAP_MAX_IF		8
+
+struct uwifi_pcap_if {
+	int			arphdr;		/* ARPHRD_xxx or -1 if unsupported */
+	uint8_t			tsresol;	/* pcapng if_tsresol */
+};
+
+struct uwifi_pcap_file {
+	unsigned char*		map;
+	size_t			map_len;
+	size_t			pos;		/* next record or block */
+	size_t			start;		/* first record or block */
+	bool			ng;		/* pcapng */
+	bool			swapped;	/* other byte order than host */
+	bool			nsec;		/* pcap with nanosecond timestamps */
+	unsigned int		if_num;
+	struct uwifi_pcap_if	ifs[UWIFI_PCAP_MAX_IF];
+};
+
+/* frame in the file, buf points directly into the mapping */
+struct uwifi_pcap_frame {
+	unsigned char*		buf;
+	size_t			len;		/* captured length */
+	size_t			orig_len;	/* original length */
+	uint64_t		ts_ns;		/* timestamp from file */
+	int			arphdr;		/* ARPHRD_xxx for uwifi_parse_raw() */
+};
+
+/**
+ * uwifi_pcap_open() - memory map a pcap or pcapng file
+ *
+ * Supported link types are plain 802.11, prism and radiotap. Frames are read
+ * directly from the mapping, there are no syscalls per frame. Frames with
+ * other link types are skipped.
+ *
+ * Return true on success, false on error.
+ */
+bool uwifi_pcap_open(struct uwifi_pcap_file* pf, const char* filename);
+
+/* return 1 for a frame, 0 at end of file or -1 for a corrupt file */
+int uwifi_pcap_next(struct uwifi_pcap_file* pf, struct uwifi_pcap_frame* f);
+
+/* start again at the first frame */
+void uwifi_pcap_rewind(struct uwifi_pcap_file* pf);
+
+void uwifi_pcap_close(struct uwifi_pcap_file* pf);
+
+struct uwifi_nodes;
+struct uwifi_essids;
+
+/**
+ * uwifi_pcap_replay() - run all frames of a file through the node pipeline
+ *
+ * @essids: may be NULL, SSIDs are interned if essids->ssids is set
+ * @timeout_sec: node timeout, 0 to disable
+ *
+ * Frames go through the same steps as in the fanout workers: parsing with a
+ * beacon cache, channel fixup with the channels seen in the file,
+ * uwifi_node_update(), uwifi_nodes_find_ap() and uwifi_essids_update(). The
+ * time is taken from the file, so node last_seen and timeouts are the same as
+ * during the capture, independent of the replay speed.
+ *
+ * Return number of frames processed or -1 for a corrupt file.
+ */
+int uwifi_pcap_replay(struct uwifi_pcap_file* pf, struct uwifi_nodes* nodes,
+		      struct uwifi_essids* essids, enum uwifi_parse_level level,
+		      unsigned int timeout_sec);
+
+/* pcapng writer, the buffer size is rounded up to a multiple of 4096 */
+#define UWIFI_PCAP_WRITE_BUFSIZE	(1 << 20)
+#define UWIFI_PCAP_WRITE_BUFSIZE_MIN	(1 << 17)
+
+struct uwifi_pcap_writer {
+	int			fd;
+	unsigned char*		buf;		/* page aligned */
+	size_t			bufsize;
+	size_t			len;		/* used part of buf */
+	bool			direct;		/* O_DIRECT */
+	unsigned int		if_num;
+};
+
+/**
+ * uwifi_pcap_writer_open() - create a pcapng file for writing
+ *
+ * @bufsize: output buffer size, 0 for UWIFI_PCAP_WRITE_BUFSIZE
+ * @direct: open with O_DIRECT, to keep large traces out of the page cache
+ *
+ * Frames are copied into the buffer and written out in large chunks, frames
+ * which don't fit anymore are written together with the buffer in one
+ * writev(). With O_DIRECT only whole pages are written until the file is
+ * closed. The writer is not thread safe.
+ *
+ * After opening at least one interface has to be added with
+ * uwifi_pcap_writer_add_if(). Return true on success, false on error.
+ */
+bool uwifi_pcap_writer_open(struct uwifi_pcap_writer* w, const char* filename,
+			    size_t bufsize, bool direct);
+
+/* add interface description block, @name and @freq (MHz) are optional.
+ * Return interface id for uwifi_pcap_write() or -1 on error */
+int uwifi_pcap_writer_add_if(struct uwifi_pcap_writer* w, int arphdr,
+			     const char* name, unsigned int freq);
+
+/* write one frame, @orig_len may be 0 if it's the same as @len */
+bool uwifi_pcap_write(struct uwifi_pcap_writer* w, int if_id, const unsigned char* buf,
+		      size_t len, size_t orig_len, uint64_t ts_ns);
+
+bool uwifi_pcap_writer_flush(struct uwifi_pcap_writer* w);
+
+/* flush and close, return false if the last write failed */
+bool uwifi_pcap_writer_close(struct uwifi_pcap_writer* w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -11,9 +11,33 @@
 
 #include "platform.h"
 
+/* the coarse clock returns the time of the last tick without reading the
+ * hardware clock, OSX has an equivalent */
+#if defined(CLOCK_MONOTONIC_COARSE)
+#define CLOCK_COARSE	CLOCK_MONOTONIC_COARSE
+#elif defined(CLOCK_MONOTONIC_RAW_APPROX)
+#define CLOCK_COARSE	CLOCK_MONOTONIC_RAW_APPROX
+#else
+#define CLOCK_COARSE	CLOCK_MONOTONIC
+#endif
+
 // return monotonic time in microseconds
 uint32_t plat_time_usec(void) {
 	struct timespec time_mono;
 	clock_gettime(CLOCK_MONOTONIC, &time_mono);
 	return time_mono.tv_sec * 1000000 + time_mono.tv_nsec / 1000;
 }
+
+uint64_t plat_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t plat_time_ns_coarse(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_COARSE, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
@@ -13,11 +13,14 @@ LIBNL		= 3.0
 BUILD_RADIOTAP	= 1
 #PCAP		= 0 #TODO revive
 
+SRC		+= linux/bpf_filter.c
+SRC		+= linux/fanout.c
 SRC		+= linux/inject_rtap.c
 SRC		+= linux/interface.c
 SRC		+= linux/netdev.c
 SRC		+= linux/netl80211.c
 SRC		+= linux/packet_sock.c
+SRC		+= linux/pcap_file.c
 SRC		+= linux/platform.c
 SRC		+= linux/raw_parser.c
 SRC		+= linux/wpa_ctrl.c
@@ -48,6 +51,8 @@ else
   endif
 endif
 
+LIBS		+= -lpthread
+
 install: lib-static lib-dynamic
 	-mkdir -p $(INST_PATH)/include/uwifi
 	-mkdir -p $(INST_PATH)/lib
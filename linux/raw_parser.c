@@ -8,6 +8,8 @@
  */
 
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
 #include <endian.h>
 
 #include "prism_header.h"
@@ -21,15 +23,61 @@
 #include "conf.h"
 #include "raw_parser.h"
 #include "netdev.h"
+#include "stats.h"
 #include "log.h"
 
+/*
+ * Radiotap fields which are not defined by all versions of the radiotap
+ * library, see http://www.radiotap.org/fields/
+ */
+#define RT_HE				23
+#define RT_HE_MU			24
+#define RT_TLV				28	/* TLVs after all other fields */
+#define RT_TLV_USIG			33
+#define RT_TLV_EHT			34
+
+#define RT_VHT_KNOWN_GI			0x0004
+#define RT_VHT_KNOWN_BANDWIDTH		0x0040
+#define RT_VHT_FLAG_SGI			0x04
+
+#define RT_HE_DATA1_BSS_COLOR_KNOWN	0x0004
+#define RT_HE_DATA1_MCS_KNOWN		0x0020
+#define RT_HE_DATA1_BW_RU_KNOWN		0x4000
+#define RT_HE_DATA2_GI_KNOWN		0x0002
+#define RT_HE_DATA3_BSS_COLOR		0x003f
+#define RT_HE_DATA3_MCS			0x0f00
+#define RT_HE_DATA5_BW_RU		0x000f
+#define RT_HE_DATA5_GI			0x0030
+#define RT_HE_DATA6_NSTS		0x000f
+
+#define RT_HE_MU_FLAGS2_BW		0x0003
+#define RT_HE_MU_FLAGS2_BW_KNOWN	0x0004
+
+#define RT_USIG_COMMON_BW_KNOWN		0x00000002
+#define RT_USIG_COMMON_BSS_COLOR_KNOWN	0x00000008
+#define RT_USIG_COMMON_BW		0x00038000
+#define RT_USIG_COMMON_BSS_COLOR	0x01f80000
+
+#define RT_EHT_KNOWN_GI			0x00000004
+#define RT_EHT_KNOWN_NSS_S		0x00020000
+#define RT_EHT_DATA0_GI			0x00000180
+#define RT_EHT_DATA7_NSS_S		0x0000f000
+#define RT_EHT_USER_MCS_KNOWN		0x00000002
+#define RT_EHT_USER_NSS_KNOWN_O		0x00000010
+#define RT_EHT_USER_MCS			0x00f00000
+#define RT_EHT_USER_NSS_O		0x0f000000
+
 /** return -1 on error, size of prism header otherwise */
 int uwifi_parse_prism_header(unsigned char* buf, int len, struct uwifi_packet* p)
 {
 	wlan_ng_prism2_header* ph = (wlan_ng_prism2_header*)buf;
 
-	if (len > 0 && (size_t)len < sizeof(wlan_ng_prism2_header))
+	UWIFI_STAT_INC(phy_headers);
+
+	if (len > 0 && (size_t)len < sizeof(wlan_ng_prism2_header)) {
+		UWIFI_STAT_INC(parse_err[UWIFI_PERR_PHY_SHORT]);
 		return -1;
+	}
 
 	/*
 	 * different drivers report S/N and rssi values differently
@@ -71,13 +119,28 @@ int uwifi_parse_prism_header(unsigned char* buf, int len, struct uwifi_packet* p
 	return sizeof(wlan_ng_prism2_header);
 }
 
-static void get_radiotap_info(struct ieee80211_radiotap_iterator *iter, struct uwifi_packet* p)
+/* VHT bandwidth field to width: 20, 40, 80 and 160MHz with sideband variants */
+static enum uwifi_chan_width rt_vht_width(unsigned char bw)
+{
+	if (bw == 0)
+		return CHAN_WIDTH_20;
+	else if (bw <= 3)
+		return CHAN_WIDTH_40;
+	else if (bw <= 10)
+		return CHAN_WIDTH_80;
+	else if (bw <= 25)
+		return CHAN_WIDTH_160;
+	return CHAN_WIDTH_UNSPEC;
+}
+
+static void get_radiotap_info(int idx, unsigned char* arg, struct uwifi_packet* p)
 {
 	uint16_t x;
 	signed char c;
 	unsigned char known, flags, ht20, lgi;
+	int rate;
 
-	switch (iter->this_arg_index) {
+	switch (idx) {
 	/* ignoring these */
 	case IEEE80211_RADIOTAP_TSFT:
 	case IEEE80211_RADIOTAP_FHSS:
@@ -97,18 +160,18 @@ static void get_radiotap_info(struct ieee80211_radiotap_iterator *iter, struct u
 		break;
 	case IEEE80211_RADIOTAP_FLAGS:
 		/* short preamble */
-		if (*iter->this_arg & IEEE80211_RADIOTAP_F_SHORTPRE) {
+		if (*arg & IEEE80211_RADIOTAP_F_SHORTPRE) {
 			p->phy_flags |= PHY_FLAG_SHORTPRE;
 		}
-		if (*iter->this_arg & IEEE80211_RADIOTAP_F_BADFCS) {
+		if (*arg & IEEE80211_RADIOTAP_F_BADFCS) {
 			p->phy_flags |= PHY_FLAG_BADFCS;
 		}
 		break;
 	case IEEE80211_RADIOTAP_RATE:
 		//TODO check!
-		//printf("\trate: %lf\n", (double)*iter->this_arg/2);
-		LOG_DBG("Radiotap: rate %0x", *iter->this_arg);
-		p->phy_rate = (*iter->this_arg)*5; /* rate is in 500kbps */
+		//printf("\trate: %lf\n", (double)*arg/2);
+		LOG_DBG("Radiotap: rate %0x", *arg);
+		p->phy_rate = (*arg)*5; /* rate is in 500kbps */
 		p->phy_rate_idx = wlan_rate_to_index(p->phy_rate);
 		break;
 #define IEEE80211_CHAN_A \
@@ -117,9 +180,9 @@ static void get_radiotap_info(struct ieee80211_radiotap_iterator *iter, struct u
 	(IEEE80211_CHAN_2GHZ | IEEE80211_CHAN_OFDM)
 	case IEEE80211_RADIOTAP_CHANNEL:
 		/* channel & channel type */
-		p->phy_freq = le16toh(*(uint16_t*)iter->this_arg);
-		iter->this_arg = iter->this_arg + 2;
-		x = le16toh(*(uint16_t*)iter->this_arg);
+		p->phy_freq = le16toh(*(uint16_t*)arg);
+		arg = arg + 2;
+		x = le16toh(*(uint16_t*)arg);
 		if ((x & IEEE80211_CHAN_A) == IEEE80211_CHAN_A) {
 			p->phy_flags |= PHY_FLAG_A;
 		}
@@ -131,7 +194,7 @@ static void get_radiotap_info(struct ieee80211_radiotap_iterator *iter, struct u
 		}
 		break;
 	case IEEE80211_RADIOTAP_DBM_ANTSIGNAL:
-		c = *(signed char*)iter->this_arg;
+		c = *(signed char*)arg;
 		LOG_DBG("Radiotap: signal %ddBm", c);
 		/* we get the signal per rx chain with newer drivers.
 		 * save the highest value, but make sure we don't override
@@ -140,25 +203,25 @@ static void get_radiotap_info(struct ieee80211_radiotap_iterator *iter, struct u
 			p->phy_signal = c;
 		break;
 	case IEEE80211_RADIOTAP_DBM_ANTNOISE:
-		LOG_DBG("Radiotap: noise %ddBm", *(signed char*)iter->this_arg);
+		LOG_DBG("Radiotap: noise %ddBm", *(signed char*)arg);
 		// usually not present
-		//p->phy_noise = *(signed char*)iter->this_arg;
+		//p->phy_noise = *(signed char*)arg;
 		break;
 	case IEEE80211_RADIOTAP_ANTENNA:
-		LOG_DBG("Radiotap: antenna %d", *iter->this_arg);
+		LOG_DBG("Radiotap: antenna %d", *arg);
 		break;
 	case IEEE80211_RADIOTAP_DB_ANTSIGNAL:
-		LOG_DBG("Radiotap: signal %ddB (ref?)", *iter->this_arg);
+		LOG_DBG("Radiotap: signal %ddB (ref?)", *arg);
 		// usually not present
-		//p->phy_snr = *iter->this_arg;
+		//p->phy_snr = *arg;
 		break;
 	case IEEE80211_RADIOTAP_DB_ANTNOISE:
-		//printf("\tantnoise: %02d\n", *iter->this_arg);
+		//printf("\tantnoise: %02d\n", *arg);
 		break;
 	case IEEE80211_RADIOTAP_MCS:
 		/* Ref http://www.radiotap.org/defined-fields/MCS */
-		known = *iter->this_arg++;
-		flags = *iter->this_arg++;
+		known = *arg++;
+		flags = *arg++;
 		if (known & IEEE80211_RADIOTAP_MCS_HAVE_BW)
 			ht20 = (flags & IEEE80211_RADIOTAP_MCS_BW_MASK) == IEEE80211_RADIOTAP_MCS_BW_20;
 		else
@@ -171,42 +234,368 @@ static void get_radiotap_info(struct ieee80211_radiotap_iterator *iter, struct u
 
 		//LOG_DBG(" %s %s", ht20 ? "HT20" : "HT40", lgi ? "LGI" : "SGI");
 
-		p->phy_rate_idx = 12 + *iter->this_arg;
+		p->phy_rate_idx = 12 + *arg;
 		p->phy_rate_flags = flags;
-		p->phy_rate = wlan_ht_mcs_to_rate(*iter->this_arg, ht20, lgi);
+		p->phy_rate = wlan_ht_mcs_to_rate(*arg, ht20, lgi);
 
 		LOG_DBG("Radiotap: MCS rate %d ", p->phy_rate);
 		break;
+	case IEEE80211_RADIOTAP_VHT:
+		/* Ref http://www.radiotap.org/fields/VHT, only the first user */
+		x = le16toh(*(uint16_t*)arg);
+		flags = arg[2];
+		if ((arg[4] & 0x0f) == 0)
+			break;
+		p->phy_flags |= PHY_FLAG_VHT;
+		p->phy_nss = arg[4] & 0x0f;
+		p->phy_rate_idx = arg[4] >> 4;
+		if (x & RT_VHT_KNOWN_BANDWIDTH)
+			p->phy_chan_width = rt_vht_width(arg[3]);
+		rate = wlan_vht_mcs_to_rate(p->phy_chan_width, p->phy_nss, p->phy_rate_idx,
+					    (x & RT_VHT_KNOWN_GI) && (flags & RT_VHT_FLAG_SGI));
+		if (rate > 0)
+			p->phy_rate = rate;
+		LOG_DBG("Radiotap: VHT MCS %d NSS %d rate %d", p->phy_rate_idx, p->phy_nss, rate);
+		break;
+	case RT_HE:
+	case RT_HE_MU:
+		/* decoded in rt_parse_he(), older radiotap libraries don't know them */
+		break;
 	default:
-		LOG_DBG("Radiotap: UNKNOWN FIELD %d", iter->this_arg_index);
+		LOG_DBG("Radiotap: UNKNOWN FIELD %d", idx);
 		break;
 	}
 }
 
+/*
+ * HE, HE-MU and the EHT TLVs
+ *
+ * The radiotap iterator stops at fields it does not know, so these are found
+ * with a walk over the presence bitmaps which only needs alignment and size
+ * of the fields before them. Vendor namespaces are skipped by their length.
+ */
+static const struct {
+	uint8_t align;
+	uint8_t size;
+} rt_align_size[] = {
+	[0] = { 8, 8 }, [1] = { 1, 1 }, [2] = { 1, 1 }, [3] = { 2, 4 },
+	[4] = { 2, 2 }, [5] = { 1, 1 }, [6] = { 1, 1 }, [7] = { 2, 2 },
+	[8] = { 2, 2 }, [9] = { 2, 2 }, [10] = { 1, 1 }, [11] = { 1, 1 },
+	[12] = { 1, 1 }, [13] = { 1, 1 }, [14] = { 2, 2 }, [15] = { 2, 2 },
+	[16] = { 1, 1 }, [17] = { 1, 1 }, [18] = { 4, 8 }, [19] = { 1, 3 },
+	[20] = { 4, 8 }, [21] = { 2, 12 }, [22] = { 8, 12 }, [23] = { 2, 12 },
+	[24] = { 2, 12 }, [25] = { 2, 6 }, [26] = { 1, 1 }, [27] = { 2, 4 },
+};
+
+#define RT_ALIGN(_off, _a)	(((_off) + (_a) - 1) & ~((_a) - 1))
+
+static const enum uwifi_chan_width rt_he_width[] = {
+	CHAN_WIDTH_20, CHAN_WIDTH_40, CHAN_WIDTH_80, CHAN_WIDTH_160,
+};
+
+static void rt_parse_he_field(unsigned char* arg, struct uwifi_packet* p)
+{
+	uint16_t d[6];
+	int i, bw, gi = 0, rate;
+
+	for (i = 0; i < 6; i++)
+		d[i] = le16toh(*(uint16_t*)(arg + i * 2));
+
+	p->phy_flags |= PHY_FLAG_HE;
+
+	if (d[0] & RT_HE_DATA1_BSS_COLOR_KNOWN)
+		p->phy_bss_color = d[2] & RT_HE_DATA3_BSS_COLOR;
+
+	if (d[0] & RT_HE_DATA1_BW_RU_KNOWN) {
+		bw = d[4] & RT_HE_DATA5_BW_RU;
+		if (bw <= 3)
+			p->phy_chan_width = rt_he_width[bw];
+		else if (bw >= 7 && bw <= 10)
+			p->phy_chan_width = rt_he_width[bw - 7];
+		else	/* 26, 52 or 106-tone RU: no rate */
+			p->phy_chan_width = CHAN_WIDTH_UNSPEC;
+	}
+
+	if (d[1] & RT_HE_DATA2_GI_KNOWN)
+		gi = (d[4] & RT_HE_DATA5_GI) >> 4;
+
+	p->phy_nss = d[5] & RT_HE_DATA6_NSTS;
+	if (p->phy_nss == 0)
+		p->phy_nss = 1;
+
+	if (!(d[0] & RT_HE_DATA1_MCS_KNOWN))
+		return;
+
+	p->phy_rate_idx = (d[2] & RT_HE_DATA3_MCS) >> 8;
+	rate = wlan_he_mcs_to_rate(p->phy_chan_width, p->phy_nss, p->phy_rate_idx, gi);
+	if (rate > 0)
+		p->phy_rate = rate;
+	LOG_DBG("Radiotap: HE MCS %d NSS %d GI %d rate %d", p->phy_rate_idx, p->phy_nss, gi, rate);
+}
+
+/* PPDU bandwidth, the HE field overrides it with the RU of this user */
+static void rt_parse_he_mu_field(unsigned char* arg, struct uwifi_packet* p)
+{
+	uint16_t flags2 = le16toh(*(uint16_t*)(arg + 2));
+
+	if (flags2 & RT_HE_MU_FLAGS2_BW_KNOWN)
+		p->phy_chan_width = rt_he_width[flags2 & RT_HE_MU_FLAGS2_BW];
+}
+
+static void rt_parse_tlvs(unsigned char* buf, int off, int rt_len, struct uwifi_packet* p)
+{
+	uint16_t type, len;
+	uint32_t known, common, data0, user, nss = 0;
+	int mcs = -1, gi = 0, rate;
+	unsigned char* v;
+
+	while (off + 4 <= rt_len) {
+		type = le16toh(*(uint16_t*)(buf + off));
+		len = le16toh(*(uint16_t*)(buf + off + 2));
+		v = buf + off + 4;
+		if (off + 4 + len > rt_len)
+			break;
+
+		if (type == RT_TLV_USIG && len >= 12) {
+			common = le32toh(*(uint32_t*)v);
+			if (common & RT_USIG_COMMON_BW_KNOWN) {
+				int bw = (common & RT_USIG_COMMON_BW) >> 15;
+				p->phy_chan_width = bw >= 4 ? CHAN_WIDTH_320
+						: bw <= 3 ? rt_he_width[bw] : CHAN_WIDTH_UNSPEC;
+			}
+			if (common & RT_USIG_COMMON_BSS_COLOR_KNOWN)
+				p->phy_bss_color = (common & RT_USIG_COMMON_BSS_COLOR) >> 19;
+		} else if (type == RT_TLV_EHT && len >= 40) {
+			p->phy_flags |= PHY_FLAG_EHT;
+			known = le32toh(*(uint32_t*)v);
+			data0 = le32toh(*(uint32_t*)(v + 4));
+			if (known & RT_EHT_KNOWN_GI)
+				gi = (data0 & RT_EHT_DATA0_GI) >> 7;
+			if (known & RT_EHT_KNOWN_NSS_S)
+				nss = (le32toh(*(uint32_t*)(v + 32)) & RT_EHT_DATA7_NSS_S) >> 12;
+			/* first user only */
+			if (len >= 44) {
+				user = le32toh(*(uint32_t*)(v + 40));
+				if (user & RT_EHT_USER_MCS_KNOWN)
+					mcs = (user & RT_EHT_USER_MCS) >> 20;
+				if (user & RT_EHT_USER_NSS_KNOWN_O)
+					nss = (user & RT_EHT_USER_NSS_O) >> 24;
+			}
+		}
+		off += 4 + RT_ALIGN(len, 4);
+	}
+
+	if (!(p->phy_flags & PHY_FLAG_EHT))
+		return;
+
+	/* NSS is coded as number of streams - 1 */
+	p->phy_nss = nss + 1;
+	if (mcs < 0)
+		return;
+
+	p->phy_rate_idx = mcs;
+	rate = wlan_eht_mcs_to_rate(p->phy_chan_width, p->phy_nss, mcs, gi);
+	if (rate > 0)
+		p->phy_rate = rate;
+	LOG_DBG("Radiotap: EHT MCS %d NSS %d GI %d rate %d", mcs, p->phy_nss, gi, rate);
+}
+
+static void rt_parse_he(unsigned char* buf, int rt_len, struct uwifi_packet* p)
+{
+	int off, nwords = 0, word, bit;
+	int he_off = -1, he_mu_off = -1;
+	bool radiotap_ns = true, tlv = false;
+	uint32_t w;
+
+	/* data starts after the last presence word */
+	do {
+		if (4 + (nwords + 1) * 4 > rt_len)
+			return;
+		memcpy(&w, buf + 4 + nwords * 4, 4);
+		nwords++;
+	} while (le32toh(w) & BIT(IEEE80211_RADIOTAP_EXT));
+
+	off = 4 + nwords * 4;
+
+	for (word = 0; word < nwords; word++) {
+		memcpy(&w, buf + 4 + word * 4, 4);
+		w = le32toh(w);
+
+		for (bit = 0; radiotap_ns && bit < IEEE80211_RADIOTAP_RADIOTAP_NAMESPACE; bit++) {
+			if (!(w & BIT(bit)))
+				continue;
+			if (bit == RT_TLV) {
+				tlv = true;
+				continue;
+			}
+			if ((unsigned int)bit >= ARRAY_SIZE(rt_align_size) ||
+			    rt_align_size[bit].size == 0) {
+				/* unknown field, nothing after it can be found
+				 * but fields before it are still valid */
+				tlv = false;
+				goto decode;
+			}
+			off = RT_ALIGN(off, rt_align_size[bit].align);
+			if (bit == RT_HE && he_off < 0)
+				he_off = off;
+			else if (bit == RT_HE_MU && he_mu_off < 0)
+				he_mu_off = off;
+			off += rt_align_size[bit].size;
+		}
+
+		if (w & BIT(IEEE80211_RADIOTAP_VENDOR_NAMESPACE)) {
+			/* OUI, sub namespace and skip length */
+			off = RT_ALIGN(off, 2);
+			if (off + 6 > rt_len)
+				return;
+			off += 6 + le16toh(*(uint16_t*)(buf + off + 4));
+			radiotap_ns = false;
+		} else if (w & BIT(IEEE80211_RADIOTAP_RADIOTAP_NAMESPACE)) {
+			radiotap_ns = true;
+		}
+	}
+
+decode:
+	if (he_mu_off >= 0 && he_mu_off + 12 <= rt_len)
+		rt_parse_he_mu_field(buf + he_mu_off, p);
+
+	if (he_off >= 0 && he_off + 12 <= rt_len)
+		rt_parse_he_field(buf + he_off, p);
+
+	if (tlv)
+		rt_parse_tlvs(buf, RT_ALIGN(off, 4), rt_len, p);
+}
+
+/*
+ * Radiotap layout cache
+ *
+ * A driver sends the same presence bitmaps for almost every frame, so the
+ * field offsets found by the radiotap iterator are remembered per bitmap and
+ * header length. Frames with a known layout are decoded directly from these
+ * offsets. Layouts with vendor namespaces are not cached because their length
+ * is part of the data. The cache is per thread, for fanout workers.
+ */
+#define RT_CACHE_SIZE	4
+#define RT_CACHE_WORDS	4
+#define RT_CACHE_FIELDS	32
+
+struct rt_layout {
+	uint16_t		rt_len;		/* 0 for unused entry */
+	uint8_t			num_words;
+	uint8_t			num_fields;
+	uint32_t		present[RT_CACHE_WORDS];
+	struct {
+		uint8_t		idx;
+		uint16_t	off;
+	}			fields[RT_CACHE_FIELDS];
+};
+
+static __thread struct rt_layout rt_cache[RT_CACHE_SIZE];
+static __thread unsigned int rt_cache_next;
+
+/* return number of presence words or -1 if the layout can't be cached */
+static int rt_present_words(unsigned char* buf, int rt_len, uint32_t* words)
+{
+	int n = 0;
+	uint32_t w;
+
+	do {
+		if (n >= RT_CACHE_WORDS || 4 + (n + 1) * 4 > rt_len)
+			return -1;
+		memcpy(&w, buf + 4 + n * 4, 4);
+		w = le32toh(w);
+		if (w & BIT(IEEE80211_RADIOTAP_VENDOR_NAMESPACE))
+			return -1;
+		words[n++] = w;
+	} while (w & BIT(IEEE80211_RADIOTAP_EXT));
+
+	return n;
+}
+
+static struct rt_layout* rt_cache_find(int rt_len, uint32_t* words, int num_words)
+{
+	int i;
+
+	for (i = 0; i < RT_CACHE_SIZE; i++) {
+		if (rt_cache[i].rt_len == rt_len &&
+		    rt_cache[i].num_words == num_words &&
+		    memcmp(rt_cache[i].present, words, num_words * 4) == 0)
+			return &rt_cache[i];
+	}
+	return NULL;
+}
+
 /* return -1 on error, 0 on bad FCS, size of radiotap header otherwise */
 int uwifi_parse_radiotap(unsigned char* buf, size_t len, struct uwifi_packet* p)
 {
 	struct ieee80211_radiotap_header* rh = (struct ieee80211_radiotap_header*)buf;
 	struct ieee80211_radiotap_iterator iter;
 	int rt_len = le16toh(rh->it_len);
+	uint32_t words[RT_CACHE_WORDS];
+	struct rt_layout* lay = NULL;
+	int num_words = -1;
+	int num_fields = 0;
+	int i;
 
-	if (len < sizeof(struct ieee80211_radiotap_header))
+	UWIFI_STAT_INC(phy_headers);
+
+	if (len < sizeof(struct ieee80211_radiotap_header)) {
+		UWIFI_STAT_INC(parse_err[UWIFI_PERR_PHY_SHORT]);
 		return -1;
+	}
+
+	if ((size_t)rt_len <= len)
+		num_words = rt_present_words(buf, rt_len, words);
+
+	if (num_words > 0)
+		lay = rt_cache_find(rt_len, words, num_words);
+
+	if (lay != NULL) {
+		for (i = 0; i < lay->num_fields; i++)
+			get_radiotap_info(lay->fields[i].idx, buf + lay->fields[i].off, p);
+		goto sanitize;
+	}
 
 	int err = ieee80211_radiotap_iterator_init(&iter, rh, rt_len, NULL);
 	if (err) {
 		LOG_DBG("Radiotap: MALFORMED HEADER (err %d)", err);
+		UWIFI_STAT_INC(parse_err[UWIFI_PERR_PHY_MALFORMED]);
 		return -1;
 	}
 
+	if (num_words > 0) {
+		lay = &rt_cache[rt_cache_next];
+		lay->rt_len = 0;
+		lay->num_words = num_words;
+		memcpy(lay->present, words, num_words * 4);
+	}
+
 	while (!(err = ieee80211_radiotap_iterator_next(&iter))) {
 		if (iter.is_radiotap_ns) {
-			get_radiotap_info(&iter, p);
+			if (lay != NULL && num_fields < RT_CACHE_FIELDS) {
+				lay->fields[num_fields].idx = iter.this_arg_index;
+				lay->fields[num_fields].off = iter.this_arg - buf;
+			}
+			num_fields++;
+			get_radiotap_info(iter.this_arg_index, iter.this_arg, p);
 		}
 	}
 
+	/* only valid layouts which fit */
+	if (lay != NULL && err == -ENOENT && num_fields <= RT_CACHE_FIELDS) {
+		lay->rt_len = rt_len;
+		lay->num_fields = num_fields;
+		rt_cache_next = (rt_cache_next + 1) % RT_CACHE_SIZE;
+	}
+
+sanitize:
+
+	if ((size_t)rt_len <= len &&
+	    le32toh(rh->it_present) & (BIT(RT_HE) | BIT(RT_HE_MU) | BIT(RT_TLV)))
+		rt_parse_he(buf, rt_len, p);
+
 	/* sanitize */
-	if (p->phy_rate == 0 || p->phy_rate > 6000) {
+	if (p->phy_rate == 0 || p->phy_rate > 500000) { /* > EHT 320MHz 16 streams */
 		/* assume min rate for mode */
 		LOG_DBG("Radiotap: *** fixing wrong rate");
 		if (p->phy_flags & PHY_FLAG_A)
@@ -225,6 +614,7 @@ int uwifi_parse_radiotap(unsigned char* buf, size_t len, struct uwifi_packet* p)
 	if (p->phy_flags & PHY_FLAG_BADFCS) {
 		/* we can't trust frames with a bad FCS - stop parsing */
 		LOG_DBG("=== bad FCS, stop ===");
+		UWIFI_STAT_INC(bad_fcs);
 		return 0;
 	} else {
 		return rt_len;
@@ -233,13 +623,31 @@ int uwifi_parse_radiotap(unsigned char* buf, size_t len, struct uwifi_packet* p)
 
 /* return -1 on error, 0 on bad FCS, size of parsed headers otherwise */
 int uwifi_parse_raw(unsigned char* buf, size_t len, struct uwifi_packet* p, int arphdr)
+{
+	return uwifi_parse_raw_level(buf, len, p, arphdr, UWIFI_PARSE_FULL);
+}
+
+int uwifi_parse_raw_level(unsigned char* buf, size_t len, struct uwifi_packet* p, int arphdr,
+			  enum uwifi_parse_level level)
+{
+	return uwifi_parse_raw_cached(buf, len, p, arphdr, level, NULL);
+}
+
+int uwifi_parse_raw_cached(unsigned char* buf, size_t len, struct uwifi_packet* p, int arphdr,
+			   enum uwifi_parse_level level, struct uwifi_beacon_cache* cache)
 {
 	int ret;
 	if (arphdr == ARPHRD_IEEE80211_PRISM) {
 		ret = uwifi_parse_prism_header(buf, len, p);
 	} else if (arphdr == ARPHRD_IEEE80211_RADIOTAP) {
 		ret = uwifi_parse_radiotap(buf, len, p);
+	} else if (arphdr == ARPHRD_IEEE80211) {
+		/* no PHY header, e.g. from capture files */
+		if (level < UWIFI_PARSE_HDR)
+			return 0;
+		return uwifi_parse_80211_header_cached(buf, len, p, level, cache);
 	} else {
+		UWIFI_STAT_INC(parse_err[UWIFI_PERR_ARPHDR]);
 		return -1;
 	}
 
@@ -250,35 +658,45 @@ int uwifi_parse_raw(unsigned char* buf, size_t len, struct uwifi_packet* p, int
 
 	if ((size_t)ret >= len) {
 		LOG_DBG("impossible len");
+		UWIFI_STAT_INC(parse_err[UWIFI_PERR_PHY_MALFORMED]);
 		return -1;
 	}
 
+	if (level < UWIFI_PARSE_HDR)
+		return ret;
+
 	int hlen = ret;
-	ret = uwifi_parse_80211_header(buf + ret, len - ret, p);
+	ret = uwifi_parse_80211_header_cached(buf + ret, len - ret, p, level, cache);
 	if (ret <= 0)
 		return ret;
 	return hlen + ret;
 }
 
-void uwifi_fixup_packet_channel(struct uwifi_packet* p, struct uwifi_interface* intf)
+void uwifi_fixup_packet_channel_idx(struct uwifi_packet* p, struct uwifi_channels* channels,
+				    int channel_idx)
 {
 	int i = -1;
 
 	/* get channel index for packet */
 	if (p->phy_freq)
-		i = uwifi_channel_idx_from_freq(&intf->channels, p->phy_freq);
+		i = uwifi_channel_idx_from_freq(channels, p->phy_freq);
 
 	/* if not found from pkt, best guess from config but it might be
 	 * unknown (-1) too */
 	if (i < 0)
-		p->pkt_chan_idx = intf->channel_idx;
+		p->pkt_chan_idx = channel_idx;
 	else
 		p->pkt_chan_idx = i;
 
 	/* wlan_channel is only known for beacons and probe response,
 	 * otherwise we set it from the physical channel */
 	if (p->wlan_channel == 0 && p->pkt_chan_idx >= 0)
-		p->wlan_channel = uwifi_channel_get_chan(&intf->channels, p->pkt_chan_idx);
+		p->wlan_channel = uwifi_channel_get_chan(channels, p->pkt_chan_idx);
+}
+
+void uwifi_fixup_packet_channel(struct uwifi_packet* p, struct uwifi_interface* intf)
+{
+	uwifi_fixup_packet_channel_idx(p, &intf->channels, intf->channel_idx);
 
 	/* if current channel is unknown (this is a mac80211 bug), guess it from
 	 * the packet */
@@ -20,6 +20,14 @@ extern "C" {
 /* return rest of packet length (may be 0) or negative value on error */
 int uwifi_parse_raw(unsigned char* buf, size_t len, struct uwifi_packet* p, int arphdr);
 
+/* same, but stop after the given parse level */
+int uwifi_parse_raw_level(unsigned char* buf, size_t len, struct uwifi_packet* p, int arphdr,
+			  enum uwifi_parse_level level);
+
+/* same, with a beacon cache for the IEs of beacons, may be NULL */
+int uwifi_parse_raw_cached(unsigned char* buf, size_t len, struct uwifi_packet* p, int arphdr,
+			   enum uwifi_parse_level level, struct uwifi_beacon_cache* cache);
+
 /* return consumed length, 0 for bad FCS, -1 on error */
 int uwifi_parse_radiotap(unsigned char* buf, size_t len, struct uwifi_packet* p);
 
@@ -28,6 +36,11 @@ int uwifi_parse_prism_header(unsigned char* buf, int len, struct uwifi_packet* p
 
 void uwifi_fixup_packet_channel(struct uwifi_packet* p, struct uwifi_interface* intf);
 
+/* same, but only reads the channel list and current channel index, for
+ * threads which must not touch the interface */
+void uwifi_fixup_packet_channel_idx(struct uwifi_packet* p, struct uwifi_channels* channels,
+				    int channel_idx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,143 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+#include "mac_hash.h"
+#include "stats.h"
+
+#define MAC_HASH_MIN_SIZE	64
+
+static inline unsigned int mac_hash_slot(const struct mac_hash* h, uint64_t key)
+{
+	/* fibonacci hashing, mixes the random low bytes of the MAC into all bits */
+	return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (h->size - 1);
+}
+
+#if UWIFI_STATS
+static void mac_hash_stats(unsigned int probes)
+{
+	UWIFI_STAT_INC(hash_lookups);
+	UWIFI_STAT_ADD(hash_probes, probes);
+	UWIFI_STAT_MAX(hash_probe_max, probes);
+}
+#else
+#define mac_hash_stats(_p)	do { } while (0)
+#endif
+
+void* mac_hash_get(const struct mac_hash* h, uint64_t key)
+{
+	unsigned int i, probes = 0;
+
+	if (h->num == 0)
+		return NULL;
+
+	for (i = mac_hash_slot(h, key); h->tbl[i].val != NULL; i = (i + 1) & (h->size - 1)) {
+		probes++;
+		if (h->tbl[i].key == key) {
+			mac_hash_stats(probes);
+			return h->tbl[i].val;
+		}
+	}
+	mac_hash_stats(probes);
+	return NULL;
+}
+
+static bool mac_hash_resize(struct mac_hash* h, unsigned int size)
+{
+	struct mac_hash_entry* old = h->tbl;
+	unsigned int old_size = h->size;
+	unsigned int i, j;
+
+	h->tbl = malloc(size * sizeof(struct mac_hash_entry));
+	if (h->tbl == NULL) {
+		h->tbl = old;
+		return false;
+	}
+	memset(h->tbl, 0, size * sizeof(struct mac_hash_entry));
+	h->size = size;
+
+	for (i = 0; i < old_size; i++) {
+		if (old[i].val == NULL)
+			continue;
+		for (j = mac_hash_slot(h, old[i].key); h->tbl[j].val != NULL;
+		     j = (j + 1) & (h->size - 1))
+			;
+		h->tbl[j] = old[i];
+	}
+
+	free(old);
+	return true;
+}
+
+/* insert or replace, return false if memory could not be allocated */
+bool mac_hash_put(struct mac_hash* h, uint64_t key, void* val)
+{
+	unsigned int i;
+
+	/* keep load factor below 3/4 */
+	if ((h->num + 1) * 4 > h->size * 3 &&
+	    !mac_hash_resize(h, h->size ? h->size * 2 : MAC_HASH_MIN_SIZE))
+		return false;
+
+	for (i = mac_hash_slot(h, key); h->tbl[i].val != NULL; i = (i + 1) & (h->size - 1)) {
+		if (h->tbl[i].key == key) {
+			h->tbl[i].val = val;
+			return true;
+		}
+	}
+
+	h->tbl[i].key = key;
+	h->tbl[i].val = val;
+	h->num++;
+	return true;
+}
+
+/* remove entry and return its value, or NULL if it was not found */
+void* mac_hash_del(struct mac_hash* h, uint64_t key)
+{
+	unsigned int i, j, k;
+	void* val;
+
+	if (h->num == 0)
+		return NULL;
+
+	for (i = mac_hash_slot(h, key); ; i = (i + 1) & (h->size - 1)) {
+		if (h->tbl[i].val == NULL)
+			return NULL;
+		if (h->tbl[i].key == key)
+			break;
+	}
+
+	val = h->tbl[i].val;
+	h->num--;
+
+	/* shift following entries back instead of leaving a tombstone */
+	for (j = (i + 1) & (h->size - 1); h->tbl[j].val != NULL; j = (j + 1) & (h->size - 1)) {
+		k = mac_hash_slot(h, h->tbl[j].key);
+		/* entry at j can move to i if its home slot is not in (i, j] */
+		if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+			h->tbl[i] = h->tbl[j];
+			i = j;
+		}
+	}
+	h->tbl[i].key = 0;
+	h->tbl[i].val = NULL;
+	return val;
+}
+
+void mac_hash_free(struct mac_hash* h)
+{
+	free(h->tbl);
+	h->tbl = NULL;
+	h->size = 0;
+	h->num = 0;
+}
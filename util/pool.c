@@ -0,0 +1,151 @@
+/*
+ * libuwifi - Userspace Wifi Library
+ *
+ * Copyright (C) 2005-2016 Bruno Randolf (br1@einfach.org)
+ *
+ * This source code is licensed under the GNU Lesser General Public License,
+ * Version 3. See the file COPYING for more details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "platform.h"
+#include "pool.h"
+#include "log.h"
+
+#define POOL_CHUNK_OBJS		256
+#define POOL_ALIGN		16
+#define POOL_HUGEPAGE_SIZE	(2 * 1024 * 1024)
+
+struct pool_obj {
+	struct pool_obj*	next;
+};
+
+/* header at the start of each chunk, objects follow */
+struct pool_chunk {
+	struct pool_chunk*	next;
+	size_t			size;
+	bool			mapped;
+} __attribute__ ((aligned(POOL_ALIGN)));
+
+void uwifi_pool_init(struct uwifi_pool* pool, size_t obj_size,
+		     unsigned int chunk_objs, unsigned int max_objs,
+		     bool hugepages)
+{
+	memset(pool, 0, sizeof(struct uwifi_pool));
+	if (obj_size < sizeof(struct pool_obj))
+		obj_size = sizeof(struct pool_obj);
+	pool->obj_size = (obj_size + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+	pool->chunk_objs = chunk_objs ? chunk_objs : POOL_CHUNK_OBJS;
+	pool->max_objs = max_objs;
+	pool->hugepages = hugepages;
+}
+
+static struct pool_chunk* pool_chunk_alloc(struct uwifi_pool* pool, size_t* size)
+{
+	struct pool_chunk* c;
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+	if (pool->hugepages) {
+		c = mmap(NULL, POOL_HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (c != MAP_FAILED) {
+			c->mapped = true;
+			*size = POOL_HUGEPAGE_SIZE;
+			return c;
+		}
+		LOG_INF("No hugepages available, using normal pages for pool");
+		pool->hugepages = false;
+	}
+#endif
+	*size = sizeof(struct pool_chunk) + pool->obj_size * pool->chunk_objs;
+	c = malloc(*size);
+	if (c != NULL)
+		c->mapped = false;
+	return c;
+}
+
+static bool pool_grow(struct uwifi_pool* pool)
+{
+	struct pool_chunk* c;
+	unsigned char* obj;
+	size_t size;
+	unsigned int i, num;
+
+	c = pool_chunk_alloc(pool, &size);
+	if (c == NULL)
+		return false;
+
+	c->size = size;
+	c->next = pool->chunks;
+	pool->chunks = c;
+
+	num = (size - sizeof(struct pool_chunk)) / pool->obj_size;
+	if (pool->max_objs && pool->num_total + num > pool->max_objs)
+		num = pool->max_objs - pool->num_total;
+
+	obj = (unsigned char*)c + sizeof(struct pool_chunk);
+	for (i = 0; i < num; i++, obj += pool->obj_size) {
+		struct pool_obj* o = (struct pool_obj*)obj;
+		o->next = pool->free_list;
+		pool->free_list = o;
+	}
+	pool->num_total += num;
+	LOG_DBG("POOL grow by %u objects to %u", num, pool->num_total);
+	return true;
+}
+
+void* uwifi_pool_alloc(struct uwifi_pool* pool)
+{
+	struct pool_obj* o;
+
+	if (pool->free_list == NULL) {
+		if (pool->max_objs && pool->num_total >= pool->max_objs)
+			return NULL;
+		if (!pool_grow(pool))
+			return NULL;
+	}
+
+	o = pool->free_list;
+	pool->free_list = o->next;
+	pool->num_used++;
+	memset(o, 0, pool->obj_size);
+	return o;
+}
+
+void uwifi_pool_free(struct uwifi_pool* pool, void* obj)
+{
+	struct pool_obj* o = obj;
+
+	if (obj == NULL)
+		return;
+
+	o->next = pool->free_list;
+	pool->free_list = o;
+	pool->num_used--;
+}
+
+void uwifi_pool_destroy(struct uwifi_pool* pool)
+{
+	struct pool_chunk *c, *next;
+
+	for (c = pool->chunks; c != NULL; c = next) {
+		next = c->next;
+#ifdef __linux__
+		if (c->mapped) {
+			munmap(c, c->size);
+			continue;
+		}
+#endif
+		free(c);
+	}
+	pool->chunks = NULL;
+	pool->free_list = NULL;
+	pool->num_used = 0;
+	pool->num_total = 0;
+}